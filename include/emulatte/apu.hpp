@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include "fundamentals.hpp"
+
+namespace emulatte
+{
+    // The audio processing unit. There's no sound
+    // yet, only the frame counter, because that's
+    // what raises the frame IRQ games sync to.
+    // How often it does depends on the region
+    // (see region.hpp), and is counted by the
+    // scheduler, so none of that lives here.
+    struct apu
+    {
+        bool five_step = false;
+        bool irq_inhibit = false;
+        bool frame_irq = false;
+
+        // Whether the frame counter should be raising
+        // IRQs at all right now.
+        bool frame_irq_enabled() const
+        {
+            return !five_step && !irq_inhibit;
+        };
+
+        // $4015. Reading it acknowledges the frame
+        // IRQ.
+        byte read_status(uint64_t& side_effects)
+        {
+            byte value = frame_irq ? 0x40 : 0x00;
+            if (frame_irq)
+            {
+                frame_irq = false;
+                ++side_effects;
+            }
+            return value;
+        };
+
+        // $4017.
+        void write_frame_counter(byte value)
+        {
+            five_step = value & 0x80;
+            irq_inhibit = value & 0x40;
+            if (irq_inhibit)
+            {
+                frame_irq = false;
+            }
+        };
+    };
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "fundamentals.hpp"
+
+namespace emulatte
+{
+    // The 8KB of battery-backed PRG-RAM some
+    // carts have at $6000-$7FFF, kept in a .sav
+    // file. The file is mapped straight into
+    // memory and the CPU writes to the mapping
+    // like any other RAM, so a save costs nothing
+    // extra per write and the file is never
+    // rewritten as a whole. The kernel writes
+    // dirty pages back on its own; we also nudge
+    // it every so often from a background thread,
+    // and wait for it when we're done.
+    class battery_ram
+    {
+    public:
+        static constexpr size_t size = 0x2000;
+
+        battery_ram() = default;
+        battery_ram(const battery_ram&) = delete;
+        battery_ram& operator=(const battery_ram&) = delete;
+
+        ~battery_ram()
+        {
+            close();
+        };
+
+        // Maps the save file, creating it (empty) if
+        // there isn't one yet.
+        bool open(const std::filesystem::path& path,
+                  std::chrono::milliseconds flush_interval = std::chrono::seconds(1))
+        {
+            close();
+            descriptor = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+            if (descriptor < 0)
+            {
+                return false;
+            }
+            // A short or missing file is padded out
+            // with zeroes; a longer one keeps its tail.
+            struct stat info;
+            if (::fstat(descriptor, &info) != 0 ||
+                (size_t(info.st_size) < size && ::ftruncate(descriptor, size) != 0))
+            {
+                close();
+                return false;
+            }
+            void* mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+            if (mapped == MAP_FAILED)
+            {
+                close();
+                return false;
+            }
+            memory = static_cast<byte*>(mapped);
+
+            flusher = std::jthread{ [this, flush_interval](std::stop_token stop)
+            {
+                std::mutex mutex;
+                std::condition_variable_any wake;
+                std::unique_lock lock{ mutex };
+                while (!wake.wait_for(lock, stop, flush_interval, [&stop] { return stop.stop_requested(); }))
+                {
+                    flush(false);
+                }
+            } };
+            return true;
+        };
+
+        // Writes the file back, without waiting for
+        // it to hit the disk unless asked to.
+        void flush(bool wait = true)
+        {
+            if (memory)
+            {
+                ::msync(memory, size, wait ? MS_SYNC : MS_ASYNC);
+            }
+        };
+
+        void close()
+        {
+            if (flusher.joinable())
+            {
+                flusher.request_stop();
+                flusher.join();
+            }
+            if (memory)
+            {
+                flush(true);
+                ::munmap(memory, size);
+                memory = nullptr;
+            }
+            if (descriptor >= 0)
+            {
+                ::close(descriptor);
+                descriptor = -1;
+            }
+        };
+
+        byte* data() const
+        {
+            return memory;
+        };
+
+    private:
+        int descriptor = -1;
+        byte* memory = nullptr;
+        std::jthread flusher;
+    };
+};
@@ -0,0 +1,576 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fundamentals.hpp"
+
+namespace emulatte
+{
+    // The RGB colour of each of the 64 palette
+    // indices the PPU puts out, on a typical NTSC
+    // TV.
+    inline constexpr std::array<uint32_t, 64> nes_palette = {
+        0x666666, 0x002A88, 0x1412A7, 0x3B00A4, 0x5C007E, 0x6E0040, 0x6C0600, 0x561D00,
+        0x333500, 0x0B4800, 0x005200, 0x004F08, 0x00404D, 0x000000, 0x000000, 0x000000,
+        0xADADAD, 0x155FD9, 0x4240FF, 0x7527FE, 0xA01ACC, 0xB71E7B, 0xB53120, 0x994E00,
+        0x6B6D00, 0x388700, 0x0C9300, 0x008F32, 0x007C8D, 0x000000, 0x000000, 0x000000,
+        0xFFFEFF, 0x64B0FF, 0x9290FF, 0xC676FF, 0xF36AFF, 0xFE6ECC, 0xFE8170, 0xEA9E22,
+        0xBCBE00, 0x88D800, 0x5CE430, 0x45E082, 0x48CDDE, 0x4F4F4F, 0x000000, 0x000000,
+        0xFFFEFF, 0xC0DFFF, 0xD3D2FF, 0xE8C8FF, 0xFBC2FF, 0xFEC4EA, 0xFECCC5, 0xF7D8A5,
+        0xE4E594, 0xCFEF96, 0xBDF4AB, 0xB3F3CC, 0xB5EBF2, 0xB8B8B8, 0x000000, 0x000000,
+    };
+
+    // Encoders for captured frames. Each one
+    // appends to an output buffer that's reused
+    // from frame to frame, so once it has grown
+    // to size nothing more is allocated.
+    namespace encode
+    {
+        static constexpr int width = 256;
+        static constexpr int height = 240;
+
+        inline void put_u32_be(std::vector<byte>& out, uint32_t value)
+        {
+            out.push_back(byte(value >> 24));
+            out.push_back(byte(value >> 16));
+            out.push_back(byte(value >> 8));
+            out.push_back(byte(value));
+        };
+
+        // The palette indices as they are, one byte
+        // a pixel.
+        inline void raw(const byte* pixels, std::vector<byte>& out)
+        {
+            out.insert(out.end(), pixels, pixels + width * height);
+        };
+
+        inline uint32_t crc32(const byte* data, size_t size, uint32_t crc = 0)
+        {
+            static const std::array<uint32_t, 256> table = []
+            {
+                std::array<uint32_t, 256> entries = {};
+                for (uint32_t n = 0; n < 256; ++n)
+                {
+                    uint32_t c = n;
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        c = (c & 1) ? 0xEDB8'8320 ^ (c >> 1) : c >> 1;
+                    }
+                    entries[n] = c;
+                }
+                return entries;
+            }();
+
+            crc = ~crc;
+            for (size_t i = 0; i < size; ++i)
+            {
+                crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+            }
+            return ~crc;
+        };
+
+        // An indexed-colour PNG with our palette in
+        // it. The pixels are stored without any
+        // compression: deflate allows that, and it
+        // keeps encoding as cheap as copying, which
+        // is the point of doing it on the fly. Any
+        // PNG tool can squeeze the files later.
+        inline void png(const byte* pixels, std::vector<byte>& out)
+        {
+            auto chunk = [&](const char* type, auto&& body)
+            {
+                size_t start = out.size();
+                put_u32_be(out, 0);
+                out.insert(out.end(), type, type + 4);
+                body();
+                uint32_t length = uint32_t(out.size() - start - 8);
+                out[start] = byte(length >> 24);
+                out[start + 1] = byte(length >> 16);
+                out[start + 2] = byte(length >> 8);
+                out[start + 3] = byte(length);
+                put_u32_be(out, crc32(out.data() + start + 4, length + 4));
+            };
+
+            static constexpr byte signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+            out.insert(out.end(), std::begin(signature), std::end(signature));
+
+            chunk("IHDR", [&]
+            {
+                put_u32_be(out, width);
+                put_u32_be(out, height);
+                // 8 bits a pixel, indexed colour, and
+                // the standard compression, filter and
+                // interlace methods.
+                out.insert(out.end(), { 8, 3, 0, 0, 0 });
+            });
+
+            chunk("PLTE", [&]
+            {
+                for (uint32_t colour : nes_palette)
+                {
+                    out.insert(out.end(), { byte(colour >> 16), byte(colour >> 8), byte(colour) });
+                }
+            });
+
+            chunk("IDAT", [&]
+            {
+                // A zlib stream of stored deflate
+                // blocks. Every row starts with its
+                // filter type, which is none.
+                constexpr size_t row = width + 1;
+                constexpr size_t total = row * height;
+                constexpr size_t block_limit = 0xFFFF;
+                out.insert(out.end(), { 0x78, 0x01 });
+
+                uint32_t a = 1;
+                uint32_t b = 0;
+                size_t done = 0;
+                while (done < total)
+                {
+                    size_t length = std::min(block_limit, total - done);
+                    bool last = done + length == total;
+                    out.insert(out.end(), { byte(last), byte(length), byte(length >> 8),
+                                            byte(~length), byte(~length >> 8) });
+                    for (size_t i = done; i < done + length; ++i)
+                    {
+                        size_t column = i % row;
+                        byte value = column == 0 ? 0 : pixels[(i / row) * width + column - 1];
+                        out.push_back(value);
+                        a = (a + value) % 65521;
+                        b = (b + a) % 65521;
+                    }
+                    done += length;
+                }
+                put_u32_be(out, (b << 16) | a);
+            });
+
+            chunk("IEND", [] {});
+        };
+
+        // QOI, which is RGB but compresses well and
+        // fast. NES frames are mostly runs and
+        // repeats of a handful of colours, which
+        // is exactly what it's good at.
+        inline void qoi(const byte* pixels, std::vector<byte>& out)
+        {
+            out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+            put_u32_be(out, width);
+            put_u32_be(out, height);
+            // RGB, sRGB.
+            out.insert(out.end(), { 3, 0 });
+
+            // The format tracks alpha even for RGB
+            // images: it starts out as opaque black,
+            // and unused index slots are transparent,
+            // so they never match a real pixel.
+            struct rgba
+            {
+                byte r = 0;
+                byte g = 0;
+                byte b = 0;
+                byte a = 0;
+                bool operator==(const rgba&) const = default;
+            };
+            std::array<rgba, 64> seen = {};
+            rgba previous = { 0, 0, 0, 255 };
+            int run = 0;
+
+            for (int i = 0; i < width * height; ++i)
+            {
+                uint32_t colour = nes_palette[pixels[i] & 0x3F];
+                rgba pixel = { byte(colour >> 16), byte(colour >> 8), byte(colour), 255 };
+                if (pixel == previous)
+                {
+                    if (++run == 62)
+                    {
+                        out.push_back(byte(0xC0 | (run - 1)));
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run)
+                {
+                    out.push_back(byte(0xC0 | (run - 1)));
+                    run = 0;
+                }
+
+                int slot = (pixel.r * 3 + pixel.g * 5 + pixel.b * 7 + 255 * 11) % 64;
+                if (seen[slot] == pixel)
+                {
+                    out.push_back(byte(slot));
+                }
+                else
+                {
+                    seen[slot] = pixel;
+                    int dr = int8_t(pixel.r - previous.r);
+                    int dg = int8_t(pixel.g - previous.g);
+                    int db = int8_t(pixel.b - previous.b);
+                    int dr_dg = dr - dg;
+                    int db_dg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                    {
+                        out.push_back(byte(0x40 | ((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+                    }
+                    else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7)
+                    {
+                        out.push_back(byte(0x80 | (dg + 32)));
+                        out.push_back(byte(((dr_dg + 8) << 4) | (db_dg + 8)));
+                    }
+                    else
+                    {
+                        out.insert(out.end(), { 0xFE, pixel.r, pixel.g, pixel.b });
+                    }
+                }
+                previous = pixel;
+            }
+            if (run)
+            {
+                out.push_back(byte(0xC0 | (run - 1)));
+            }
+            out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+        };
+    };
+
+    // Writes finished frames, and the audio that
+    // went with them, to disk in the background.
+    //
+    // The emulation thread only ever copies into
+    // a buffer from a fixed pool and hands it to
+    // a queue. A pool of workers takes it from
+    // there: encodes the frame, writes it out as
+    // its own file with a single write, and puts
+    // the buffer back.
+    //
+    // Audio doesn't go through the pool at all.
+    // It's small and needs no encoding, so it's
+    // added to one staging buffer as it's
+    // submitted, which keeps it in order for free,
+    // and whichever worker is free writes it out
+    // in large blocks.
+    //
+    // If the disk can't keep up and the pool runs
+    // dry, frames are dropped and counted rather
+    // than holding the emulator up - unless every
+    // frame matters more than speed, in which case
+    // submit() can wait for a buffer instead. Only
+    // the picture is ever dropped: the audio is
+    // kept either way, so it never falls out of
+    // step with the frames that are there.
+    class capture
+    {
+    public:
+        enum class format
+        {
+            Raw,
+            Png,
+            Qoi,
+        };
+
+        enum class overflow
+        {
+            Drop,
+            Wait,
+        };
+
+        // About 800 samples a frame at 48kHz, with
+        // plenty to spare.
+        static constexpr size_t max_samples = 4096;
+
+        capture() = default;
+        capture(const capture&) = delete;
+        capture& operator=(const capture&) = delete;
+
+        ~capture()
+        {
+            close();
+        };
+
+        // Starts writing into the given directory,
+        // which is created if need be.
+        bool open(const std::filesystem::path& directory, format kind,
+                  overflow when_full = overflow::Drop, int workers = 2, int buffers = 8)
+        {
+            close();
+            std::error_code error;
+            std::filesystem::create_directories(directory, error);
+            audio_file = std::fopen((directory / "audio.pcm").string().c_str(), "wb");
+            if (error || !audio_file)
+            {
+                return false;
+            }
+
+            output = directory;
+            type = kind;
+            full_policy = when_full;
+            dropped_frames = 0;
+            // Staging gets room for a second block,
+            // for when the last one is still being
+            // written as this one fills up.
+            audio_staging.clear();
+            audio_staging.reserve(audio_flush_size * 2);
+            audio_pending.clear();
+            audio_pending.reserve(audio_flush_size * 2);
+            audio_waiting = false;
+            audio_writing = false;
+
+            // Both lists can hold every buffer, so
+            // neither ever has to grow.
+            pool.resize(std::max(buffers, 1));
+            free_jobs.reserve(pool.size());
+            queued.assign(pool.size(), nullptr);
+            queued_first = 0;
+            queued_count = 0;
+            for (job& buffer : pool)
+            {
+                free_jobs.push_back(&buffer);
+            }
+            for (int i = 0; i < std::max(workers, 1); ++i)
+            {
+                threads.emplace_back([this](std::stop_token stop) { work(stop); });
+            }
+            return true;
+        };
+
+        // Waits for everything queued to be written,
+        // then stops the workers.
+        void close()
+        {
+            if (threads.empty())
+            {
+                return;
+            }
+            {
+                std::unique_lock lock{ mutex };
+                released.wait(lock, [this] { return queued_count == 0 && busy == 0 && !audio_waiting && !audio_writing; });
+            }
+            for (std::jthread& thread : threads)
+            {
+                thread.request_stop();
+            }
+            threads.clear();
+            flush_audio();
+            std::fclose(audio_file);
+            audio_file = nullptr;
+            queued.clear();
+            free_jobs.clear();
+            pool.clear();
+        };
+
+        bool is_open() const
+        {
+            return !threads.empty();
+        };
+
+        // Queues a frame (256x240 palette indices)
+        // and, optionally, the 16-bit samples
+        // produced during it. Returns false if the
+        // frame had to be dropped; its samples are
+        // kept all the same.
+        bool submit(uint64_t frame, const byte* pixels, const int16_t* samples = nullptr, size_t sample_count = 0)
+        {
+            job* buffer = nullptr;
+            {
+                std::unique_lock lock{ mutex };
+                if (samples)
+                {
+                    append_audio(samples, std::min(sample_count, max_samples));
+                }
+                if (full_policy == overflow::Wait)
+                {
+                    released.wait(lock, [this] { return !free_jobs.empty(); });
+                }
+                if (free_jobs.empty())
+                {
+                    ++dropped_frames;
+                    return false;
+                }
+                buffer = free_jobs.back();
+                free_jobs.pop_back();
+            }
+
+            buffer->frame = frame;
+            std::copy_n(pixels, buffer->pixels.size(), buffer->pixels.begin());
+
+            {
+                std::lock_guard lock{ mutex };
+                queued[(queued_first + queued_count++) % queued.size()] = buffer;
+            }
+            ready.notify_one();
+            return true;
+        };
+
+        uint64_t dropped() const
+        {
+            std::lock_guard lock{ mutex };
+            return dropped_frames;
+        };
+
+    private:
+        struct job
+        {
+            uint64_t frame = 0;
+            std::array<byte, encode::width * encode::height> pixels = {};
+        };
+
+        static constexpr size_t audio_flush_size = 1 << 16;
+
+        void work(std::stop_token stop)
+        {
+            // Each worker keeps its own output buffer
+            // for encoding into.
+            std::vector<byte> encoded;
+            encoded.reserve(encode::width * encode::height * 4);
+
+            // And its own file name, which only ever
+            // has the frame number and extension
+            // swapped out, so naming a file doesn't
+            // allocate either.
+            const char* extension = type == format::Png ? ".png" : type == format::Qoi ? ".qoi" : ".raw";
+            std::string path = (output / "frame_").string();
+            size_t prefix = path.size();
+            path.reserve(prefix + 32);
+
+            while (true)
+            {
+                job* current = nullptr;
+                {
+                    std::unique_lock lock{ mutex };
+                    if (!ready.wait(lock, stop, [this] { return queued_count != 0 || audio_waiting; }))
+                    {
+                        return;
+                    }
+                    // A block of audio waiting to go
+                    // out comes first; it's what keeps
+                    // the staging buffer from growing.
+                    if (audio_waiting)
+                    {
+                        audio_waiting = false;
+                        audio_writing = true;
+                        lock.unlock();
+                        write_audio();
+                        continue;
+                    }
+                    current = queued[queued_first];
+                    queued_first = (queued_first + 1) % queued.size();
+                    --queued_count;
+                    ++busy;
+                }
+
+                encoded.clear();
+                switch (type)
+                {
+                case format::Png:
+                    encode::png(current->pixels.data(), encoded);
+                    break;
+                case format::Qoi:
+                    encode::qoi(current->pixels.data(), encoded);
+                    break;
+                default:
+                    encode::raw(current->pixels.data(), encoded);
+                    break;
+                }
+
+                char name[32];
+                std::snprintf(name, sizeof(name), "%06llu%s", (unsigned long long)current->frame, extension);
+                path.resize(prefix);
+                path += name;
+                if (std::FILE* file = std::fopen(path.c_str(), "wb"))
+                {
+                    std::fwrite(encoded.data(), 1, encoded.size(), file);
+                    std::fclose(file);
+                }
+
+                {
+                    std::lock_guard lock{ mutex };
+                    free_jobs.push_back(current);
+                    --busy;
+                }
+                released.notify_all();
+            }
+        };
+
+        // Called with the mutex held, in the order
+        // frames are submitted. Once a block's worth
+        // has built up it's swapped out for the
+        // (empty) pending buffer and handed to a
+        // worker, so nobody waits on the disk while
+        // holding the lock. Only one block is out at
+        // a time, which keeps the file in order;
+        // until it's written, staging just keeps
+        // filling, into the room left for that.
+        void append_audio(const int16_t* samples, size_t count)
+        {
+            const byte* data = reinterpret_cast<const byte*>(samples);
+            audio_staging.insert(audio_staging.end(), data, data + count * sizeof(int16_t));
+            if (audio_staging.size() >= audio_flush_size && !audio_waiting && !audio_writing)
+            {
+                audio_staging.swap(audio_pending);
+                audio_waiting = true;
+                ready.notify_one();
+            }
+        };
+
+        // Called without the mutex, by the worker
+        // that took the pending block.
+        void write_audio()
+        {
+            if (audio_file)
+            {
+                std::fwrite(audio_pending.data(), 1, audio_pending.size(), audio_file);
+            }
+            audio_pending.clear();
+            {
+                std::lock_guard lock{ mutex };
+                audio_writing = false;
+            }
+            released.notify_all();
+        };
+
+        // Writes out whatever is left, once the
+        // workers have all stopped.
+        void flush_audio()
+        {
+            if (audio_file && !audio_staging.empty())
+            {
+                std::fwrite(audio_staging.data(), 1, audio_staging.size(), audio_file);
+            }
+            audio_staging.clear();
+        };
+
+        std::filesystem::path output;
+        format type = format::Raw;
+        overflow full_policy = overflow::Drop;
+        std::FILE* audio_file = nullptr;
+        std::vector<byte> audio_staging;
+        std::vector<byte> audio_pending;
+        // A block is waiting in audio_pending for a
+        // worker to pick it up, or one has and is
+        // writing it.
+        bool audio_waiting = false;
+        bool audio_writing = false;
+
+        std::vector<job> pool;
+        std::vector<job*> free_jobs;
+        // A ring of buffers waiting to be written,
+        // oldest first.
+        std::vector<job*> queued;
+        size_t queued_first = 0;
+        size_t queued_count = 0;
+        uint64_t dropped_frames = 0;
+        int busy = 0;
+
+        mutable std::mutex mutex;
+        std::condition_variable_any ready;
+        std::condition_variable released;
+        std::vector<std::jthread> threads;
+    };
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "fundamentals.hpp"
+
+namespace emulatte
+{
+    // The contents of an iNES (.nes) file. The
+    // header is 16 bytes, followed by an optional
+    // 512 byte trainer, then the PRG ROM in 16KB
+    // banks and the CHR ROM in 8KB banks.
+    struct cartridge
+    {
+        std::vector<byte> prg;
+        std::vector<byte> chr;
+        byte mapper = 0;
+        // Nametable mirroring, straight from bit 0
+        // of header byte 6.
+        bool vertical_mirroring = false;
+        // Whether the cartridge keeps its PRG RAM
+        // alive with a battery.
+        bool battery = false;
+        // Which console the game was made for. Old
+        // iNES headers can only say PAL or not (bit
+        // 0 of byte 9, which is rarely set); NES 2.0
+        // ones have a proper field in byte 12.
+        enum class timing : byte
+        {
+            Ntsc,
+            Pal,
+            // Works on either.
+            Multiple,
+            Dendy,
+        };
+        timing region = timing::Ntsc;
+
+        // Reads the file at the given path. Returns
+        // false if the file can't be read or isn't
+        // an iNES image, leaving us untouched.
+        bool load(const std::filesystem::path& path)
+        {
+            std::ifstream file{ path, std::ios::binary };
+            if (!file)
+            {
+                return false;
+            }
+
+            byte header[16] = {};
+            if (!file.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+                header[0] != 'N' || header[1] != 'E' || header[2] != 'S' || header[3] != 0x1A)
+            {
+                return false;
+            }
+
+            // Skip the trainer, we don't use it.
+            if (header[6] & 0b0000'0100)
+            {
+                file.seekg(512, std::ios::cur);
+            }
+
+            std::vector<byte> new_prg(header[4] * 0x4000);
+            std::vector<byte> new_chr(header[5] * 0x2000);
+            if (new_prg.empty() ||
+                !file.read(reinterpret_cast<char*>(new_prg.data()), new_prg.size()) ||
+                !file.read(reinterpret_cast<char*>(new_chr.data()), new_chr.size()))
+            {
+                return false;
+            }
+
+            prg = std::move(new_prg);
+            chr = std::move(new_chr);
+            mapper = (header[7] & 0xF0) | (header[6] >> 4);
+            vertical_mirroring = header[6] & 0b0000'0001;
+            battery = header[6] & 0b0000'0010;
+            bool nes2 = (header[7] & 0b0000'1100) == 0b0000'1000;
+            region = nes2 ? timing(header[12] & 0b0000'0011)
+                          : (header[9] & 0b0000'0001) ? timing::Pal : timing::Ntsc;
+            return true;
+        };
+    };
+};
@@ -1,8 +1,20 @@
 #pragma once
 
-#include <vector>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <bitset>
+#include <cstdint>
+#include <atomic>
+#include <functional>
+#include <memory>
 
+#include "apu.hpp"
 #include "fundamentals.hpp"
+#include "memory_page.hpp"
+#include "ppu.hpp"
+#include "region.hpp"
+#include "scheduler.hpp"
 
 namespace emulatte
 {
@@ -10,7 +22,7 @@ namespace emulatte
     // opcode is a byte, and is structured in such
     // a way that you can deduce multiple things
     // about it just by its value. However, I will
-    // just be creating a vector of every opcode
+    // just be creating a table of every opcode
     // (all 255 of them!)
     // The default instruction will be "BRK".
     struct instruction
@@ -83,284 +95,325 @@ namespace emulatte
             // second address by the Y register.
             IndirectY,
         } mode = addressing_mode::Implicit;
+        // The base number of CPU cycles this opcode
+        // takes. Page crossings and taken branches
+        // add to this when the instruction is run.
+        byte cycles = 7;
+        // What the opcode does with its operand.
+        // This matters as soon as the operand is a
+        // register on the bus, because reading or
+        // writing one has side effects, so we must
+        // only ever touch it the way the real chip
+        // does.
+        enum class access_type
+        {
+            // Only looks at the operand - loads,
+            // arithmetic, compares, and so on.
+            Read,
+            // Only stores to it, never reading it
+            // first.
+            Write,
+            // Reads it, changes it, and writes it
+            // back - the shifts, INC and DEC.
+            ReadModifyWrite,
+            // Doesn't touch it at all. JMP and JSR
+            // only care about the address itself.
+            None,
+        } access = access_type::Read;
     };
 
-    // By using a vector sorted by opcode value, we
-    // can effectively index each opcode directly,
-    // simply given a byte.
-    std::vector<instruction> instruction_set =
-    {
-        { 0, "BRK", instruction::addressing_mode::Implicit },
-        { 1, "ORA", instruction::addressing_mode::IndirectX },
-        { 2, "JAM", instruction::addressing_mode::Implicit },
-        { 3, "SLO", instruction::addressing_mode::IndirectX },
-        { 4, "NOP", instruction::addressing_mode::ZeroPage },
-        { 5, "ORA", instruction::addressing_mode::ZeroPage },
-        { 6, "ASL", instruction::addressing_mode::ZeroPage },
-        { 7, "SLO", instruction::addressing_mode::ZeroPage },
-        { 8, "PHP", instruction::addressing_mode::Implicit },
-        { 9, "ORA", instruction::addressing_mode::Immediate },
-        { 10, "ASL", instruction::addressing_mode::Accumulator },
-        { 11, "ANC", instruction::addressing_mode::Immediate },
-        { 12, "NOP", instruction::addressing_mode::Absolute },
-        { 13, "ORA", instruction::addressing_mode::Absolute },
-        { 14, "ASL", instruction::addressing_mode::Absolute },
-        { 15, "SLO", instruction::addressing_mode::Absolute },
-        { 16, "BPL", instruction::addressing_mode::Relative },
-        { 17, "ORA", instruction::addressing_mode::IndirectY },
-        { 18, "JAM", instruction::addressing_mode::Implicit },
-        { 19, "SLO", instruction::addressing_mode::IndirectY },
-        { 20, "NOP", instruction::addressing_mode::ZeroPageX },
-        { 21, "ORA", instruction::addressing_mode::ZeroPageX },
-        { 22, "ASL", instruction::addressing_mode::ZeroPageX },
-        { 23, "SLO", instruction::addressing_mode::ZeroPageX },
-        { 24, "CLC", instruction::addressing_mode::Implicit },
-        { 25, "ORA", instruction::addressing_mode::AbsoluteY },
-        { 26, "NOP", instruction::addressing_mode::Implicit },
-        { 27, "SLO", instruction::addressing_mode::AbsoluteY },
-        { 28, "NOP", instruction::addressing_mode::AbsoluteX },
-        { 29, "ORA", instruction::addressing_mode::AbsoluteX },
-        { 30, "ASL", instruction::addressing_mode::AbsoluteX },
-        { 31, "SLO", instruction::addressing_mode::AbsoluteX },
-        { 32, "JSR", instruction::addressing_mode::Absolute },
-        { 33, "AND", instruction::addressing_mode::IndirectX },
-        { 34, "JAM", instruction::addressing_mode::Implicit },
-        { 35, "RLA", instruction::addressing_mode::IndirectX },
-        { 36, "BIT", instruction::addressing_mode::ZeroPage },
-        { 37, "AND", instruction::addressing_mode::ZeroPage },
-        { 38, "ROL", instruction::addressing_mode::ZeroPage },
-        { 39, "RLA", instruction::addressing_mode::ZeroPage },
-        { 40, "PLP", instruction::addressing_mode::Implicit },
-        { 41, "AND", instruction::addressing_mode::Immediate },
-        { 42, "ROL", instruction::addressing_mode::Accumulator },
-        { 43, "ANC", instruction::addressing_mode::Immediate },
-        { 44, "BIT", instruction::addressing_mode::Absolute },
-        { 45, "AND", instruction::addressing_mode::Absolute },
-        { 46, "ROL", instruction::addressing_mode::Absolute },
-        { 47, "RLA", instruction::addressing_mode::Absolute },
-        { 48, "BMI", instruction::addressing_mode::Relative },
-        { 49, "AND", instruction::addressing_mode::IndirectY },
-        { 50, "JAM", instruction::addressing_mode::Implicit },
-        { 51, "RLA", instruction::addressing_mode::IndirectY },
-        { 52, "NOP", instruction::addressing_mode::ZeroPageX },
-        { 53, "AND", instruction::addressing_mode::ZeroPageX },
-        { 54, "ROL", instruction::addressing_mode::ZeroPageX },
-        { 55, "RLA", instruction::addressing_mode::ZeroPageX },
-        { 56, "SEC", instruction::addressing_mode::Implicit },
-        { 57, "AND", instruction::addressing_mode::AbsoluteY },
-        { 58, "NOP", instruction::addressing_mode::Implicit },
-        { 59, "RLA", instruction::addressing_mode::AbsoluteY },
-        { 60, "NOP", instruction::addressing_mode::AbsoluteX },
-        { 61, "AND", instruction::addressing_mode::AbsoluteX },
-        { 62, "ROL", instruction::addressing_mode::AbsoluteX },
-        { 63, "RLA", instruction::addressing_mode::AbsoluteX },
-        { 64, "RTI", instruction::addressing_mode::Implicit },
-        { 65, "EOR", instruction::addressing_mode::IndirectX },
-        { 66, "JAM", instruction::addressing_mode::Implicit },
-        { 67, "SRE", instruction::addressing_mode::IndirectX },
-        { 68, "NOP", instruction::addressing_mode::ZeroPage },
-        { 69, "EOR", instruction::addressing_mode::ZeroPage },
-        { 70, "LSR", instruction::addressing_mode::ZeroPage },
-        { 71, "SRE", instruction::addressing_mode::ZeroPage },
-        { 72, "PHA", instruction::addressing_mode::Implicit },
-        { 73, "EOR", instruction::addressing_mode::Immediate },
-        { 74, "LSR", instruction::addressing_mode::Accumulator },
-        { 75, "ALR", instruction::addressing_mode::Immediate },
-        { 76, "JMP", instruction::addressing_mode::Absolute },
-        { 77, "EOR", instruction::addressing_mode::Absolute },
-        { 78, "LSR", instruction::addressing_mode::Absolute },
-        { 79, "SRE", instruction::addressing_mode::Absolute },
-        { 80, "BVC", instruction::addressing_mode::Relative },
-        { 81, "EOR", instruction::addressing_mode::IndirectY },
-        { 82, "JAM", instruction::addressing_mode::Implicit },
-        { 83, "SRE", instruction::addressing_mode::IndirectY },
-        { 84, "NOP", instruction::addressing_mode::ZeroPageX },
-        { 85, "EOR", instruction::addressing_mode::ZeroPageX },
-        { 86, "LSR", instruction::addressing_mode::ZeroPageX },
-        { 87, "SRE", instruction::addressing_mode::ZeroPageX },
-        { 88, "CLI", instruction::addressing_mode::Implicit },
-        { 89, "EOR", instruction::addressing_mode::AbsoluteY },
-        { 90, "NOP", instruction::addressing_mode::Implicit },
-        { 91, "SRE", instruction::addressing_mode::AbsoluteY },
-        { 92, "NOP", instruction::addressing_mode::AbsoluteX },
-        { 93, "EOR", instruction::addressing_mode::AbsoluteX },
-        { 94, "LSR", instruction::addressing_mode::AbsoluteX },
-        { 95, "SRE", instruction::addressing_mode::AbsoluteX },
-        { 96, "RTS", instruction::addressing_mode::Implicit },
-        { 97, "ADC", instruction::addressing_mode::IndirectX },
-        { 98, "JAM", instruction::addressing_mode::Implicit },
-        { 99, "RRA", instruction::addressing_mode::IndirectX },
-        { 100, "NOP", instruction::addressing_mode::ZeroPage },
-        { 101, "ADC", instruction::addressing_mode::ZeroPage },
-        { 102, "ROR", instruction::addressing_mode::ZeroPage },
-        { 103, "RRA", instruction::addressing_mode::ZeroPage },
-        { 104, "PLA", instruction::addressing_mode::Implicit },
-        { 105, "ADC", instruction::addressing_mode::Immediate },
-        { 106, "ROR", instruction::addressing_mode::Accumulator },
-        { 107, "ARR", instruction::addressing_mode::Immediate },
-        { 108, "JMP", instruction::addressing_mode::Indirect },
-        { 109, "ADC", instruction::addressing_mode::Absolute },
-        { 110, "ROR", instruction::addressing_mode::Absolute },
-        { 111, "RRA", instruction::addressing_mode::Absolute },
-        { 112, "BVS", instruction::addressing_mode::Relative },
-        { 113, "ADC", instruction::addressing_mode::IndirectY },
-        { 114, "JAM", instruction::addressing_mode::Implicit },
-        { 115, "RRA", instruction::addressing_mode::IndirectY },
-        { 116, "NOP", instruction::addressing_mode::ZeroPageX },
-        { 117, "ADC", instruction::addressing_mode::ZeroPageX },
-        { 118, "ROR", instruction::addressing_mode::ZeroPageX },
-        { 119, "RRA", instruction::addressing_mode::ZeroPageX },
-        { 120, "SEI", instruction::addressing_mode::Implicit },
-        { 121, "ADC", instruction::addressing_mode::AbsoluteY },
-        { 122, "NOP", instruction::addressing_mode::Implicit },
-        { 123, "RRA", instruction::addressing_mode::AbsoluteY },
-        { 124, "NOP", instruction::addressing_mode::AbsoluteX },
-        { 125, "ADC", instruction::addressing_mode::AbsoluteX },
-        { 126, "ROR", instruction::addressing_mode::AbsoluteX },
-        { 127, "RRA", instruction::addressing_mode::AbsoluteX },
-        { 128, "NOP", instruction::addressing_mode::Immediate },
-        { 129, "STA", instruction::addressing_mode::IndirectX },
-        { 130, "NOP", instruction::addressing_mode::Immediate },
-        { 131, "SAX", instruction::addressing_mode::IndirectX },
-        { 132, "STY", instruction::addressing_mode::ZeroPage },
-        { 133, "STA", instruction::addressing_mode::ZeroPage },
-        { 134, "STX", instruction::addressing_mode::ZeroPage },
-        { 135, "SAX", instruction::addressing_mode::ZeroPage },
-        { 136, "DEY", instruction::addressing_mode::Implicit },
-        { 137, "NOP", instruction::addressing_mode::Immediate },
-        { 138, "TXA", instruction::addressing_mode::Implicit },
-        { 139, "ANE", instruction::addressing_mode::Immediate },
-        { 140, "STY", instruction::addressing_mode::Absolute },
-        { 141, "STA", instruction::addressing_mode::Absolute },
-        { 142, "STX", instruction::addressing_mode::Absolute },
-        { 143, "SAX", instruction::addressing_mode::Absolute },
-        { 144, "BCC", instruction::addressing_mode::Relative },
-        { 145, "STA", instruction::addressing_mode::IndirectY },
-        { 146, "JAM", instruction::addressing_mode::Implicit },
-        { 147, "SHA", instruction::addressing_mode::IndirectY },
-        { 148, "STY", instruction::addressing_mode::ZeroPageX },
-        { 149, "STA", instruction::addressing_mode::ZeroPageX },
-        { 150, "STX", instruction::addressing_mode::ZeroPageY },
-        { 151, "SAX", instruction::addressing_mode::ZeroPageY },
-        { 152, "TYA", instruction::addressing_mode::Implicit },
-        { 153, "STA", instruction::addressing_mode::AbsoluteY },
-        { 154, "TXS", instruction::addressing_mode::Implicit },
-        { 155, "TAS", instruction::addressing_mode::AbsoluteY },
-        { 156, "SHY", instruction::addressing_mode::AbsoluteX },
-        { 157, "STA", instruction::addressing_mode::AbsoluteX },
-        { 158, "SHX", instruction::addressing_mode::AbsoluteY },
-        { 159, "SHA", instruction::addressing_mode::AbsoluteY },
-        { 160, "LDY", instruction::addressing_mode::Immediate },
-        { 161, "LDA", instruction::addressing_mode::IndirectX },
-        { 162, "LDX", instruction::addressing_mode::Immediate },
-        { 163, "LAX", instruction::addressing_mode::IndirectX },
-        { 164, "LDY", instruction::addressing_mode::ZeroPage },
-        { 165, "LDA", instruction::addressing_mode::ZeroPage },
-        { 166, "LDX", instruction::addressing_mode::ZeroPage },
-        { 167, "LAX", instruction::addressing_mode::ZeroPage },
-        { 168, "TAY", instruction::addressing_mode::Implicit },
-        { 169, "LDA", instruction::addressing_mode::Immediate },
-        { 170, "TAX", instruction::addressing_mode::Implicit },
-        { 171, "LXA", instruction::addressing_mode::Immediate },
-        { 172, "LDY", instruction::addressing_mode::Absolute },
-        { 173, "LDA", instruction::addressing_mode::Absolute },
-        { 174, "LDX", instruction::addressing_mode::Absolute },
-        { 175, "LAX", instruction::addressing_mode::Absolute },
-        { 176, "BCS", instruction::addressing_mode::Relative },
-        { 177, "LDA", instruction::addressing_mode::IndirectY },
-        { 178, "JAM", instruction::addressing_mode::Implicit },
-        { 179, "LAX", instruction::addressing_mode::IndirectY },
-        { 180, "LDY", instruction::addressing_mode::ZeroPageX },
-        { 181, "LDA", instruction::addressing_mode::ZeroPageX },
-        { 182, "LDX", instruction::addressing_mode::ZeroPageY },
-        { 183, "LAX", instruction::addressing_mode::ZeroPageY },
-        { 184, "CLV", instruction::addressing_mode::Implicit },
-        { 185, "LDA", instruction::addressing_mode::AbsoluteY },
-        { 186, "TSX", instruction::addressing_mode::Implicit },
-        { 187, "LAS", instruction::addressing_mode::AbsoluteY },
-        { 188, "LDY", instruction::addressing_mode::AbsoluteX },
-        { 189, "LDA", instruction::addressing_mode::AbsoluteX },
-        { 190, "LDX", instruction::addressing_mode::AbsoluteY },
-        { 191, "LAX", instruction::addressing_mode::AbsoluteY },
-        { 192, "CPY", instruction::addressing_mode::Immediate },
-        { 193, "CMP", instruction::addressing_mode::IndirectX },
-        { 194, "NOP", instruction::addressing_mode::Immediate },
-        { 195, "DCP", instruction::addressing_mode::IndirectX },
-        { 196, "CPY", instruction::addressing_mode::ZeroPage },
-        { 197, "CMP", instruction::addressing_mode::ZeroPage },
-        { 198, "DEC", instruction::addressing_mode::ZeroPage },
-        { 199, "DCP", instruction::addressing_mode::ZeroPage },
-        { 200, "INY", instruction::addressing_mode::Implicit },
-        { 201, "CMP", instruction::addressing_mode::Immediate },
-        { 202, "DEX", instruction::addressing_mode::Implicit },
-        { 203, "SBX", instruction::addressing_mode::Immediate },
-        { 204, "CPY", instruction::addressing_mode::Absolute },
-        { 205, "CMP", instruction::addressing_mode::Absolute },
-        { 206, "DEC", instruction::addressing_mode::Absolute },
-        { 207, "DCP", instruction::addressing_mode::Absolute },
-        { 208, "BNE", instruction::addressing_mode::Relative },
-        { 209, "CMP", instruction::addressing_mode::IndirectY },
-        { 210, "JAM", instruction::addressing_mode::Implicit },
-        { 211, "DCP", instruction::addressing_mode::IndirectY },
-        { 212, "NOP", instruction::addressing_mode::ZeroPageX },
-        { 213, "CMP", instruction::addressing_mode::ZeroPageX },
-        { 214, "DEC", instruction::addressing_mode::ZeroPageX },
-        { 215, "DCP", instruction::addressing_mode::ZeroPageX },
-        { 216, "CLD", instruction::addressing_mode::Implicit },
-        { 217, "CMP", instruction::addressing_mode::AbsoluteY },
-        { 218, "NOP", instruction::addressing_mode::Implicit },
-        { 219, "DCP", instruction::addressing_mode::AbsoluteY },
-        { 220, "NOP", instruction::addressing_mode::AbsoluteX },
-        { 221, "CMP", instruction::addressing_mode::AbsoluteX },
-        { 222, "DEC", instruction::addressing_mode::AbsoluteX },
-        { 223, "DCP", instruction::addressing_mode::AbsoluteX },
-        { 224, "CPX", instruction::addressing_mode::Immediate },
-        { 225, "SBC", instruction::addressing_mode::IndirectX },
-        { 226, "NOP", instruction::addressing_mode::Immediate },
-        { 227, "ISC", instruction::addressing_mode::IndirectX },
-        { 228, "CPX", instruction::addressing_mode::ZeroPage },
-        { 229, "SBC", instruction::addressing_mode::ZeroPage },
-        { 230, "INC", instruction::addressing_mode::ZeroPage },
-        { 231, "ISC", instruction::addressing_mode::ZeroPage },
-        { 232, "INX", instruction::addressing_mode::Implicit },
-        { 233, "SBC", instruction::addressing_mode::Immediate },
-        { 234, "NOP", instruction::addressing_mode::Implicit },
-        { 235, "USBC", instruction::addressing_mode::Immediate },
-        { 236, "CPX", instruction::addressing_mode::Absolute },
-        { 237, "SBC", instruction::addressing_mode::Absolute },
-        { 238, "INC", instruction::addressing_mode::Absolute },
-        { 239, "ISC", instruction::addressing_mode::Absolute },
-        { 240, "BEQ", instruction::addressing_mode::Relative },
-        { 241, "SBC", instruction::addressing_mode::IndirectY },
-        { 242, "JAM", instruction::addressing_mode::Implicit },
-        { 243, "ISC", instruction::addressing_mode::IndirectY },
-        { 244, "NOP", instruction::addressing_mode::ZeroPageX },
-        { 245, "SBC", instruction::addressing_mode::ZeroPageX },
-        { 246, "INC", instruction::addressing_mode::ZeroPageX },
-        { 247, "ISC", instruction::addressing_mode::ZeroPageX },
-        { 248, "SED", instruction::addressing_mode::Implicit },
-        { 249, "SBC", instruction::addressing_mode::AbsoluteY },
-        { 250, "NOP", instruction::addressing_mode::Implicit },
-        { 251, "ISC", instruction::addressing_mode::AbsoluteY },
-        { 252, "NOP", instruction::addressing_mode::AbsoluteX },
-        { 253, "SBC", instruction::addressing_mode::AbsoluteX },
-        { 254, "INC", instruction::addressing_mode::AbsoluteX },
-        { 255, "ISC", instruction::addressing_mode::AbsoluteX }
-    };
+    // Every opcode, indexed by its value. The
+    // table itself is in cpu.cpp.
+    extern const std::array<instruction, 0x100> instruction_set;
 
     // This is effectively going to be a 6502,
-    // just in code.
-    struct cpu
+    // just in code. The instructions are the same
+    // in every region; only the registers on our
+    // bus need to know which one they're in, as
+    // they schedule things on its clock.
+    template <typename Region>
+    struct basic_cpu
     {
+        using scheduler = basic_scheduler<Region>;
+
         // A simple structure to make memory read
         // and writes easier.
-        struct
+        struct bus
         {
-            // We use a vector because we want to
-            // put the 64KB on the heap, it's too
-            // much to just have on the stack at
-            // all times.
-            std::vector<byte> internal_memory = std::vector<byte>(0x10000);
+            // The 2KB of internal RAM. It's small
+            // enough that copies of the bus always get
+            // their own, and it's one piece, so it can
+            // be handed out as is.
+            std::array<byte, 0x800> ram = {};
+            // Everything else, a page at a time. Pages
+            // are shared between copies of the bus
+            // until one of them writes to a page, and
+            // only then does it take its own copy of
+            // that page (see memory_page.hpp). ROM is
+            // never written, so it's always shared,
+            // and mirrored ROM pages are the same page.
+            //
+            // The table of pages is shared the same
+            // way, so a copy doesn't have to count
+            // itself into every page it shares: that
+            // only happens if it goes on to change the
+            // table, by writing to a page or mapping a
+            // different one in. Changes go through
+            // own_pages(); everything else can read
+            // the table as it is.
+            using page = memory_page;
+            using page_table = std::array<std::shared_ptr<page>, 0x100>;
+            std::shared_ptr<page_table> pages;
+            // Pages that live somewhere in particular,
+            // like battery RAM mapped from a save
+            // file. They're always written in place,
+            // and a copy of the bus gets its own copy
+            // of them up front, so its writes never
+            // end up in our file (or ours in its).
+            std::array<bool, 0x100> pinned = {};
+            // Set for bare CPU tests, which expect a
+            // flat 64KB of plain memory.
+            bool flat = false;
+            // Registers we don't emulate yet are
+            // backed by this single byte, so code
+            // that touches them keeps running
+            // instead of reading out of bounds.
+            byte open_bus = 0x00;
+            // The two controller ports. Buttons are
+            // one bit each, A first: A, B, Select,
+            // Start, Up, Down, Left, Right. Writing
+            // bit 0 of $4016 latches them, and then
+            // each read of $4016/$4017 shifts out the
+            // next button of that port.
+            std::array<byte, 2> controllers = {};
+            std::array<byte, 2> controller_shift = {};
+            bool controller_strobe = false;
+            // Counts everything that has changed the
+            // state of the machine through the bus:
+            // every write, and every read that does
+            // more than look (like a controller read
+            // shifting the next button out). If this
+            // hasn't moved, nothing the CPU did has
+            // changed what it would see next time.
+            uint64_t side_effects = 0;
+            // The chips on the other end of the
+            // registers. The system plugs these in;
+            // without them the registers are just
+            // open bus.
+            ppu* video = nullptr;
+            apu* audio = nullptr;
+            scheduler* events = nullptr;
+            // The IRQ line is shared, and held low
+            // while any of these is asking for it.
+            static constexpr byte irq_frame_counter = 0b0000'0001;
+            static constexpr byte irq_mapper = 0b0000'0010;
+            byte irq_sources = 0;
+            // The page last written to $4014, which
+            // the OAM DMA copies from.
+            byte dma_page = 0x00;
+
+            // The page table. The address space is cut
+            // into 256 pages of 256 bytes, and each one
+            // either points straight at the memory
+            // behind it, or is null if it has to go
+            // through read_register/write_register.
+            // Mirrors are just pages pointing at the
+            // same memory, and read-only pages are
+            // only missing from write_pages. Almost
+            // every access is one lookup and one load.
+            //
+            // Only RAM and pinned pages, which are never
+            // shared, are in write_pages. Any other
+            // page could be shared at any time - a copy
+            // of us can be taken whenever, and taking
+            // one doesn't touch us - so writes to them
+            // always go through own_page(), which is
+            // where we find out whether we still have
+            // a page to ourselves.
+            std::array<byte*, 0x100> read_pages = {};
+            std::array<byte*, 0x100> write_pages = {};
+            // Watchpoints use the same trick. A page
+            // being watched is pulled out of the page
+            // table, with its real pointer parked here,
+            // so only accesses to it take the slow
+            // path and get reported to on_watch. Every
+            // other page stays as fast as ever.
+            std::array<byte*, 0x100> parked_reads = {};
+            std::array<byte*, 0x100> parked_writes = {};
+            std::array<bool, 0x100> watched_reads = {};
+            std::array<bool, 0x100> watched_writes = {};
+            std::function<void(word addy, byte value, bool write)> on_watch;
+
+            bus() :
+                pages{ std::make_shared<page_table>() }
+            {
+                std::fill(pages->begin() + 0x40, pages->end(), blank_page());
+                map_pages();
+            };
+
+            // Copying is cheap: the copy shares all
+            // our pages, and whichever of us writes to
+            // one first copies it then. It only reads
+            // from the bus it copies, but that means it
+            // can't overlap with that bus being used on
+            // another thread.
+            bus(const bus& other)
+            {
+                *this = other;
+            };
+
+            bus& operator=(const bus& other)
+            {
+                if (this == &other)
+                {
+                    return *this;
+                }
+                ram = other.ram;
+                pages = other.pages;
+                flat = other.flat;
+                pinned = {};
+                for (int page = 0; page < 0x100; ++page)
+                {
+                    if (other.pinned[page])
+                    {
+                        own_pages()[page] = std::make_shared<bus::page>(*(*other.pages)[page]);
+                    }
+                }
+                open_bus = other.open_bus;
+                controllers = other.controllers;
+                controller_shift = other.controller_shift;
+                controller_strobe = other.controller_strobe;
+                side_effects = other.side_effects;
+                video = other.video;
+                audio = other.audio;
+                events = other.events;
+                irq_sources = other.irq_sources;
+                dma_page = other.dma_page;
+                // Watches belong to whoever set them
+                // up on the original, not to the copy.
+                parked_reads = {};
+                parked_writes = {};
+                watched_reads = {};
+                watched_writes = {};
+                on_watch = nullptr;
+                map_pages();
+                return *this;
+            };
+
+            // Every page is plain memory: no registers,
+            // no mirrors, no ROM. Bare CPU tests expect
+            // a flat 64KB they can read and write.
+            void map_flat()
+            {
+                flat = true;
+                page_table& table = own_pages();
+                std::fill(table.begin(), table.begin() + 0x40, blank_page());
+                map_pages();
+            };
+
+            // Puts memory that lives elsewhere behind
+            // a range of pages, in place. The owner is
+            // kept alive for as long as any page still
+            // points into it.
+            void pin_pages(int first, int count, std::shared_ptr<void> owner, byte* memory)
+            {
+                page_table& table = own_pages();
+                for (int page = 0; page < count; ++page)
+                {
+                    table[first + page] = std::shared_ptr<bus::page>(owner, reinterpret_cast<bus::page*>(memory + page * 0x100));
+                    pinned[first + page] = true;
+                }
+                map_pages();
+            };
+
+            // Whether the CPU can write to a page of
+            // ours (rather than to registers, or ROM).
+            bool is_writable(int page) const
+            {
+                return flat || (page > 0x40 && page < 0x80);
+            };
+
+            // The standard layout. The 2KB of RAM shows
+            // up four times below $2000, the registers
+            // live in $2000-$3FFF and $4000-$401F, and
+            // everything from $8000 up is ROM. Only RAM
+            // and pinned pages are written straight
+            // away.
+            void map_pages()
+            {
+                for (int page = 0; page < 0x100; ++page)
+                {
+                    byte* backing = nullptr;
+                    if (page < 0x20 && !flat)
+                    {
+                        backing = &ram[(page & 0x07) << 8];
+                    }
+                    else if (page > 0x40 || flat)
+                    {
+                        backing = (*pages)[page]->data();
+                    }
+                    read_pages[page] = backing;
+                    write_pages[page] = nullptr;
+                    if (page < 0x20 && !flat)
+                    {
+                        write_pages[page] = backing;
+                    }
+                    else if (is_writable(page) && pinned[page])
+                    {
+                        write_pages[page] = backing;
+                    }
+                    // Pages being watched stay trapped,
+                    // with their new pointers parked.
+                    if (watched_reads[page])
+                    {
+                        parked_reads[page] = read_pages[page];
+                        read_pages[page] = nullptr;
+                    }
+                    if (watched_writes[page])
+                    {
+                        parked_writes[page] = write_pages[page];
+                        write_pages[page] = nullptr;
+                    }
+                }
+            };
+
+            // The page table, made ours alone first if
+            // anyone else still has it.
+            page_table& own_pages()
+            {
+                if (pages.use_count() > 1)
+                {
+                    pages = std::make_shared<page_table>(*pages);
+                }
+                else
+                {
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                }
+                return *pages;
+            };
+
+            // What's in a page, for looking at.
+            const page& page_at(int page) const
+            {
+                return *(*pages)[page];
+            };
+
+            // Makes sure one of our pages is ours alone
+            // before it's written, and gives back where
+            // it now lives. Reads follow it there.
+            byte* own_page(int page)
+            {
+                if (pinned[page])
+                {
+                    return (*pages)[page]->data();
+                }
+                byte* backing = emulatte::own_page(own_pages()[page]);
+                if (is_writable(page))
+                {
+                    (watched_reads[page] ? parked_reads : read_pages)[page] = backing;
+                }
+                return backing;
+            };
 
             // We return by reference so that memory
             // can be modified after a read call.
@@ -369,52 +422,216 @@ namespace emulatte
             // memory.
             byte& read(address addy)
             {
-                if ((addy >= 0x2000 && addy <= 0x2007) || addy == 0x4014)
+                if (byte* page = read_pages[addy.value >> 8])
                 {
-                    // ppu registers. for now, we'll
-                    // make a runtime crash.
-                    return internal_memory[0x10000];
+                    return page[addy.value & 0xFF];
                 }
-                else if (addy >= 0x4000 && addy <= 0x4019)
+                return read_slow(addy.value);
+            };
+
+            // The inverse of the read operation,
+            // just a simple write.
+            void write(address addy, byte value)
+            {
+                ++side_effects;
+                if (byte* page = write_pages[addy.value >> 8])
                 {
-                    // apu registers. this will also
-                    // be a runtime crash for now.
-                    return internal_memory[0x10000];
+                    page[addy.value & 0xFF] = value;
+                    return;
+                }
+                write_slow(addy.value, value);
+            };
+
+            // Starts or stops watching a page. Its
+            // real pointers are parked while it is
+            // watched, and put back afterwards.
+            void watch_page(byte page, bool reads, bool writes)
+            {
+                if (watched_reads[page])
+                {
+                    read_pages[page] = parked_reads[page];
+                    parked_reads[page] = nullptr;
+                }
+                if (watched_writes[page])
+                {
+                    write_pages[page] = parked_writes[page];
+                    parked_writes[page] = nullptr;
+                }
+                watched_reads[page] = reads;
+                watched_writes[page] = writes;
+                if (reads)
+                {
+                    parked_reads[page] = read_pages[page];
+                    read_pages[page] = nullptr;
+                }
+                if (writes)
+                {
+                    parked_writes[page] = write_pages[page];
+                    write_pages[page] = nullptr;
+                }
+            };
+
+            // Everything that isn't a plain page
+            // comes through here: it's either a
+            // watched page, or registers.
+            byte& read_slow(word addy)
+            {
+                byte* parked = parked_reads[addy >> 8];
+                byte& value = parked ? parked[addy & 0xFF] : read_register(addy);
+                if (watched_reads[addy >> 8] && on_watch)
+                {
+                    on_watch(addy, value, false);
+                }
+                return value;
+            };
+
+            void write_slow(word addy, byte value)
+            {
+                if (byte* parked = parked_writes[addy >> 8])
+                {
+                    parked[addy & 0xFF] = value;
+                }
+                else if (is_writable(addy >> 8))
+                {
+                    own_page(addy >> 8)[addy & 0xFF] = value;
                 }
                 else
                 {
-                    return internal_memory[addy];
+                    write_register(addy, value);
+                }
+                if (watched_writes[addy >> 8] && on_watch)
+                {
+                    on_watch(addy, value, true);
                 }
             };
 
-            // The inverse of the read operation,
-            // just a simple write.
-            void write(address addy, byte value)
+            byte& read_register(word addy)
             {
-                if ((addy >= 0x2000 && addy <= 0x2007) || addy == 0x4014)
+                if (addy >= 0x2000 && addy < 0x4000)
+                {
+                    // The PPU's 8 registers repeat all
+                    // the way up to $3FFF.
+                    if (video)
+                    {
+                        open_bus = video->read(addy, side_effects);
+                    }
+                    return open_bus;
+                }
+                else if (addy == 0x4015 && audio)
                 {
-                    // ppu registers. for now, we'll
-                    // make a runtime crash.
-                    internal_memory[0x10000] = value;
+                    open_bus = audio->read_status(side_effects) | (open_bus & 0x20);
+                    if (!audio->frame_irq)
+                    {
+                        irq_sources &= ~irq_frame_counter;
+                    }
+                    return open_bus;
+                }
+                else if (addy == 0x4016 || addy == 0x4017)
+                {
+                    int port = addy - 0x4016;
+                    if (controller_strobe)
+                    {
+                        controller_shift[port] = controllers[port];
+                    }
+                    // Once all 8 buttons are out, an
+                    // official pad keeps returning 1s.
+                    // The upper bits are open bus, which
+                    // is usually $40 from the address.
+                    open_bus = 0x40 | (controller_shift[port] & 1);
+                    ++side_effects;
+                    controller_shift[port] = 0x80 | (controller_shift[port] >> 1);
+                    return open_bus;
                 }
                 else if (addy >= 0x4000 && addy <= 0x4019)
                 {
-                    // apu registers. this will also
-                    // be a runtime crash for now.
-                    internal_memory[0x10000] = value;
+                    // apu registers. these also land
+                    // on the open bus byte for now.
+                    return open_bus;
                 }
                 else
                 {
-                    internal_memory[addy] = value;
+                    return (*(*pages)[addy >> 8])[addy & 0xFF];
+                }
+            };
+
+            void write_register(word addy, byte value)
+            {
+                if (addy >= 0x2000 && addy < 0x4000)
+                {
+                    open_bus = value;
+                    // Turning NMIs on during vblank fires
+                    // one immediately, so let everything
+                    // know it's due now.
+                    if (video && video->write(addy, value) && events)
+                    {
+                        events->schedule(scheduler::event::Nmi, events->now());
+                    }
+                }
+                else if (addy == 0x4014)
+                {
+                    // The copy itself happens once this
+                    // instruction is done, when the CPU
+                    // would stop to let it through.
+                    dma_page = value;
+                    if (events)
+                    {
+                        events->schedule(scheduler::event::OamDma, events->now());
+                    }
+                }
+                else if (addy == 0x4017 && audio)
+                {
+                    audio->write_frame_counter(value);
+                    if (!audio->frame_irq)
+                    {
+                        irq_sources &= ~irq_frame_counter;
+                    }
+                    if (events)
+                    {
+                        if (audio->frame_irq_enabled())
+                        {
+                            events->schedule(scheduler::event::FrameIrq,
+                                             events->now() + Region::frame_irq_first * scheduler::cpu_divider);
+                        }
+                        else
+                        {
+                            events->cancel(scheduler::event::FrameIrq);
+                        }
+                    }
                 }
+                else if (addy == 0x4016)
+                {
+                    controller_strobe = value & 1;
+                    if (controller_strobe)
+                    {
+                        controller_shift[0] = controllers[0];
+                        controller_shift[1] = controllers[1];
+                    }
+                }
+                else if (addy >= 0x4000 && addy <= 0x4019)
+                {
+                    // apu registers, same as above.
+                    open_bus = value;
+                }
+                else if (addy < 0x4100)
+                {
+                    own_page(addy >> 8)[addy & 0xFF] = value;
+                }
+                // Anything else is ROM, which just
+                // ignores writes.
             };
         } memory;
 
         address PC = 0x0000;
+        // The running total of CPU cycles. Every
+        // bit of timing in the system is derived
+        // from this, so it never wraps in practice.
+        uint64_t cycles = 0;
         byte A = 0x00;
         byte X = 0x00;
         byte Y = 0x00;
-        byte S = 0xFF;
+        // The stack pointer comes up as 0, and the
+        // reset sequence takes it to $FD.
+        byte S = 0x00;
         union
         {
             byte value = 0;
@@ -431,6 +648,68 @@ namespace emulatte
             };
         } P;
 
+        // Lots of games sit in a loop like
+        //
+        //     wait: LDA $2002
+        //           BPL wait
+        //
+        // until something outside the CPU happens.
+        // Every pass through it is identical, so
+        // there's no point emulating them one by
+        // one. Whenever we jump backwards we note
+        // the registers and the side effect count
+        // at the loop's head. If we arrive there
+        // again with nothing changed, the pass in
+        // between was a pure function of memory that
+        // nobody touched, and so will every pass be
+        // until the next outside event. We then skip
+        // as many whole passes as fit before
+        // run_limit, landing on the exact cycle we
+        // would have reached by running them.
+        struct idle_loop
+        {
+            word head = 0;
+            byte A = 0;
+            byte X = 0;
+            byte Y = 0;
+            byte S = 0;
+            byte P = 0;
+            uint64_t side_effects = ~uint64_t(0);
+            uint64_t cycles = 0;
+
+            bool repeats(const idle_loop& other) const
+            {
+                return head == other.head && A == other.A && X == other.X && Y == other.Y &&
+                       S == other.S && P == other.P && side_effects == other.side_effects;
+            };
+        } idle;
+        bool skip_idle_loops = true;
+        // Set by the JAM opcodes. Only a reset gets
+        // the CPU going again.
+        bool jammed = false;
+        uint64_t idle_cycles_skipped = 0;
+        // How many instructions have been run, not
+        // counting the passes of idle loops we
+        // skipped.
+        uint64_t instructions = 0;
+        // When the next thing outside the CPU is
+        // due to happen. Idle loops are never
+        // skipped past this.
+        uint64_t run_limit = ~uint64_t(0);
+
+        // Debugging. breakpoints is only set while a
+        // debugger has some, and is checked before
+        // every instruction - but only by a separate
+        // copy of the run loop, so there's no cost
+        // at all without them. stop_requested is how
+        // a debugger tells whoever is running us to
+        // hand control back. resume_from lets it
+        // restart on a breakpoint without stopping
+        // there again straight away.
+        const std::bitset<0x10000>* breakpoints = nullptr;
+        bool stop_requested = false;
+        int resume_from = -1;
+
         void push(byte value)
         {
             memory.write(S-- + 0x100, value);
@@ -444,505 +723,120 @@ namespace emulatte
 
         byte pull()
         {
-            return memory.read(++S);
+            return memory.read(++S + 0x100);
         };
 
         address pull_address()
         {
-            return address{ memory.read(++S), memory.read(++S) };
+            byte lo = pull();
+            byte hi = pull();
+            return address{ lo, hi };
         };
 
-        byte& get_desired_byte(instruction::addressing_mode mode, std::pair<byte, byte>& operands)
+        // The interpreter itself lives in cpu.cpp,
+        // where it's compiled once for each region
+        // (see the bottom of this file), rather
+        // than again everywhere this is included.
+
+        // Works out which address an instruction's
+        // operand lives at. This only makes sense
+        // for the modes that point into memory.
+        // Indexed modes also report whether the
+        // index carried into the next page.
+        word effective_address(instruction::addressing_mode mode, std::pair<byte, byte>& operands, bool& crossed);
+
+        // Runs one instruction, already looked up
+        // from the opcode at PC.
+        void handle_instruction(instruction inst);
+
+        // Skips the rest of an idle loop, if we're
+        // in one (see idle_loop above).
+        void check_idle_loop();
+
+        // The 2A03 has no decimal mode, so this is
+        // binary only whatever D says. V is set
+        // when both inputs have the same sign and
+        // the result doesn't.
+        void add_with_carry(byte value);
+
+        // Taken branches cost one extra cycle, and
+        // one more on top if the destination is on
+        // a different page than the next opcode.
+        void branch(byte offset, byte& cycles_taken);
+
+        // Fetch the opcode at PC and run it.
+        void step();
+
+        // Interrupts are only taken between batches,
+        // which normally end when an event is due.
+        // The one thing that can let an IRQ in while
+        // nothing else happens is clearing I with
+        // the line already held, so in that case
+        // we cut the batch short right here.
+        void irq_check()
         {
-            using enum instruction::addressing_mode;
-            switch (mode)
+            if (memory.irq_sources && !P.I)
             {
-            case Relative:
-            case Immediate:
-                return operands.first;
-            case Implicit:
-            case Accumulator:
-                return A;
-            case ZeroPage:
-                return memory.read(operands.first);
-            case ZeroPageX:
-                return memory.read(operands.first + X);
-            case ZeroPageY:
-                return memory.read(operands.first + Y);
-            case Absolute:
-                return memory.read(address{ operands.first, operands.second });
-            case AbsoluteX:
-                return memory.read(address{ address{ operands.first, operands.second } + X });
-            case AbsoluteY:
-                return memory.read(address{ address{ operands.first, operands.second } + Y });
-            case Indirect:
-                return memory.read(address{ memory.read(address{ operands.first, operands.second }),
-                                            memory.read(address{ operands.first, operands.second } + 1) });
-            case IndirectX:
-                return memory.read(address{ memory.read(operands.first + X), memory.read(operands.first + X + 1) });
-            case IndirectY:
-                return memory.read(address{ memory.read(operands.first), memory.read(operands.first + 1) } + Y);
+                run_limit = 0;
             }
         };
 
-        void handle_instruction(instruction inst)
+        // Pushes PC and P (without B) and jumps
+        // through the given vector.
+        void interrupt(word vector)
         {
-            std::pair<byte, byte> operands = {};
-            byte bytes_consumed = 1;
-            byte cycles_taken = 2;
-
-            using enum instruction::addressing_mode;
-            switch (inst.mode)
+            if (jammed)
             {
-            case Immediate:
-            case ZeroPage:
-            case ZeroPageX:
-            case ZeroPageY:
-            case Relative:
-            case IndirectX:
-            case IndirectY:
-                operands.first = memory.read(PC.value + 1);
-                bytes_consumed = 2;
-                break;
-            case Indirect:
-            case Absolute:
-            case AbsoluteX:
-            case AbsoluteY:
-                operands.first = memory.read(PC.value + 1);
-                operands.second = memory.read(PC.value + 2);
-                bytes_consumed = 3;
-                break;
-            default:
-                break;
+                return;
             }
+            push(PC);
+            push(byte((P.value | 0b0010'0000) & 0b1110'1111));
+            P.I = 1;
+            PC = address{ memory.read(vector), memory.read(vector + 1) };
+            cycles += 7;
+        };
 
-            byte& operand = get_desired_byte(inst.mode, operands);
+        void nmi()
+        {
+            interrupt(0xFFFA);
+        };
 
-            switch (inst.value)
-            {
-            case 0x69:
-            case 0x65:
-            case 0x75:
-            case 0x6D:
-            case 0x7D:
-            case 0x79:
-            case 0x61:
-            case 0x71: // ADC
-            {
-                word result = A + operand + P.C;
-                P.V = bool((A ^ byte(result >> 1)) & (operand ^ byte(result >> 1)) & 0b0100'0000);
-                P.C = bool(result & 0b1'0000'0000);
-                A = result >> 1;
-                P.N = bool(A & 0b1000'0000);
-                P.Z = A == 0;
-                break;
-            }
-            case 0xE9:
-            case 0xE5:
-            case 0xF5:
-            case 0xED:
-            case 0xFD:
-            case 0xF9:
-            case 0xE1:
-            case 0xF1: // SBC
-            {
-                word result = A + ~operand + P.C;
-                P.V = bool((A ^ byte(result >> 1)) & (operand ^ byte(result >> 1)) & 0b0100'0000);
-                P.C = bool(result & 0b1'0000'0000);
-                A = result >> 1;
-                P.N = bool(A & 0b1000'0000);
-                P.Z = A == 0;
-                break;
-            }
-            case 0x29:
-            case 0x25:
-            case 0x35:
-            case 0x2D:
-            case 0x3D:
-            case 0x39:
-            case 0x21:
-            case 0x31: // AND
-                A &= operand;
-                P.N = bool(A & 0b1000'0000);
-                P.Z = A == 0;
-                break;
-            case 0x09:
-            case 0x05:
-            case 0x15:
-            case 0x0D:
-            case 0x1D:
-            case 0x19:
-            case 0x01:
-            case 0x11: // ORA
-                A |= operand;
-                P.N = bool(A & 0b1000'0000);
-                P.Z = A == 0;
-                break;
-            case 0x49:
-            case 0x45:
-            case 0x55:
-            case 0x4D:
-            case 0x5D:
-            case 0x59:
-            case 0x41:
-            case 0x51: // EOR
-                A ^= operand;
-                P.N = bool(A & 0b1000'0000);
-                P.Z = A == 0;
-                break;
-            case 0x0A:
-            case 0x06:
-            case 0x16:
-            case 0x0E:
-            case 0x1E: // ASL
-                P.C = bool(operand & 0b1000'0000);
-                operand <<= 1;
-                P.N = bool(operand & 0b1000'0000);
-                P.Z = operand == 0;
-                break;
-            case 0x4A:
-            case 0x46:
-            case 0x56:
-            case 0x4E:
-            case 0x5E: // LSR
-                P.C = bool(operand & 0b0000'0001);
-                operand >>= 1;
-                P.N = bool(operand & 0b1000'0000);
-                P.Z = operand == 0;
-                break;
-            case 0x2A:
-            case 0x26:
-            case 0x36:
-            case 0x2E:
-            case 0x3E: // ROL
-            {
-                word result = operand << 1;
-                result &= P.C;
-                P.C = bool(result & 0b1'0000'0000);
-                operand = result & 0b1111'1111;
-                P.N = bool(operand & 0b1000'0000);
-                P.Z = operand == 0;
-                break;
-            }
-            case 0x6A:
-            case 0x66:
-            case 0x76:
-            case 0x6E:
-            case 0x7E: // ROR
+        // IRQs are ignored while I is set. It's a
+        // level, so it'll still be there once it
+        // gets cleared.
+        void irq()
+        {
+            if (memory.irq_sources && !P.I)
             {
-                word result = operand;
-                result &= word(P.C) << 8;
-                P.C = result & 0b0000'0001;
-                operand = result >> 1;
-                P.N = bool(operand & 0b1000'0000);
-                P.Z = operand == 0;
-                break;
-            }
-            case 0xA9:
-            case 0xA5:
-            case 0xB5:
-            case 0xAD:
-            case 0xBD:
-            case 0xB9:
-            case 0xA1:
-            case 0xB1: // LDA
-                A = operand;
-                P.N = bool(A & 0b1000'0000);
-                P.Z = A == 0;
-                break;
-            case 0xA2:
-            case 0xA6:
-            case 0xB6:
-            case 0xAE:
-            case 0xBE: // LDX
-                X = operand;
-                P.N = bool(X & 0b1000'0000);
-                P.Z = X == 0;
-                break;
-            case 0xA0:
-            case 0xA4:
-            case 0xB4:
-            case 0xAC:
-            case 0xBC: // LDY
-                Y = operand;
-                P.N = bool(Y & 0b1000'0000);
-                P.Z = Y == 0;
-                break;
-            case 0x85:
-            case 0x95:
-            case 0x8D:
-            case 0x9D:
-            case 0x99:
-            case 0x81:
-            case 0x91: // STA
-                operand = A;
-                break;
-            case 0x86:
-            case 0x96:
-            case 0x8E: // STX
-                operand = X;
-                break;
-            case 0x84:
-            case 0x94:
-            case 0x8C: // STY
-                operand = Y;
-                break;
-            case 0xC6:
-            case 0xD6:
-            case 0xCE:
-            case 0xDE: // DEC
-                --operand;
-                P.N = bool(operand & 0b1000'0000);
-                P.Z = operand == 0;
-                break;
-            case 0xCA: // DEX
-                --X;
-                P.N = bool(X & 0b1000'0000);
-                P.Z = X == 0;
-                break;
-            case 0x88: // DEY
-                --Y;
-                P.N = bool(Y & 0b1000'0000);
-                P.Z = Y == 0;
-                break;
-            case 0xE6:
-            case 0xF6:
-            case 0xEE:
-            case 0xFE: // INC
-                ++operand;
-                P.N = bool(operand & 0b1000'0000);
-                P.Z = operand == 0;
-                break;
-            case 0xE8: // INX
-                ++X;
-                P.N = bool(X & 0b1000'0000);
-                P.Z = X == 0;
-                break;
-            case 0xC8: // INY
-                ++Y;
-                P.N = bool(Y & 0b1000'0000);
-                P.Z = Y == 0;
-                break;
-            case 0xC9:
-            case 0xC5:
-            case 0xD5:
-            case 0xCD:
-            case 0xDD:
-            case 0xD9:
-            case 0xC1:
-            case 0xD1: // CMP
-                if (A < operand)
-                {
-                    P.N = bool((A - operand) & 0b1000'0000);
-                    P.Z = 0;
-                    P.C = 0;
-                }
-                else if (A > operand)
-                {
-                    P.N = bool((A - operand) & 0b1000'0000);
-                    P.Z = 0;
-                    P.C = 1;
-                }
-                else if (A == operand)
-                {
-                    P.N = 0;
-                    P.Z = 1;
-                    P.C = 1;
-                }
-                break;
-            case 0xE0:
-            case 0xE4:
-            case 0xEC: // CPX
-                if (X < operand)
-                {
-                    P.N = bool((X - operand) & 0b1000'0000);
-                    P.Z = 0;
-                    P.C = 0;
-                }
-                else if (X > operand)
-                {
-                    P.N = bool((X - operand) & 0b1000'0000);
-                    P.Z = 0;
-                    P.C = 1;
-                }
-                else if (X == operand)
-                {
-                    P.N = 0;
-                    P.Z = 1;
-                    P.C = 1;
-                }
-                break;
-            case 0xC0:
-            case 0xC4:
-            case 0xCC: // CPY
-                if (Y < operand)
-                {
-                    P.N = bool((Y - operand) & 0b1000'0000);
-                    P.Z = 0;
-                    P.C = 0;
-                }
-                else if (Y > operand)
-                {
-                    P.N = bool((Y - operand) & 0b1000'0000);
-                    P.Z = 0;
-                    P.C = 1;
-                }
-                else if (Y == operand)
-                {
-                    P.N = 0;
-                    P.Z = 1;
-                    P.C = 1;
-                }
-                break;
-            case 0x90: // BCC
-                if (P.C == 0)
-                {
-                    PC.value += std::bit_cast<int8_t, byte>(operand);
-                }
-                break;
-            case 0xB0: // BCS
-                if (P.C == 1)
-                {
-                    PC.value += std::bit_cast<int8_t, byte>(operand);
-                }
-                break;
-            case 0xD0: // BNE
-                if (P.Z == 0)
-                {
-                    PC.value += std::bit_cast<int8_t, byte>(operand);
-                }
-                break;
-            case 0xF0: // BEQ
-                if (P.Z == 1)
-                {
-                    PC.value += std::bit_cast<int8_t, byte>(operand);
-                }
-                break;
-            case 0x10: // BPL
-                if (P.N == 0)
-                {
-                    PC.value += std::bit_cast<int8_t, byte>(operand);
-                }
-                break;
-            case 0x30: // BMI
-                if (P.N == 1)
-                {
-                    PC.value += std::bit_cast<int8_t, byte>(operand);
-                }
-                break;
-            case 0x50: // BVC
-                if (P.V == 0)
-                {
-                    PC.value += std::bit_cast<int8_t, byte>(operand);
-                }
-                break;
-            case 0x70: // BVS
-                if (P.V == 1)
-                {
-                    PC.value += std::bit_cast<int8_t, byte>(operand);
-                }
-                break;
-            case 0x18: // CLC
-                P.C = 0;
-                break;
-            case 0x38: // SEC
-                P.C = 1;
-                break;
-            case 0xD8: // CLD
-                P.b3 = 0;
-                break;
-            case 0xF8: // SED
-                P.b3 = 1;
-                break;
-            case 0x58: // CLI
-                P.I = 0;
-                break;
-            case 0x78: // SEI
-                P.I = 1;
-                break;
-            case 0xB8: // CLV
-                P.V = 0;
-                break;
-            case 0x24:
-            case 0x2C: // BIT
-                P.N = bool(operand & 0b1000'0000);
-                P.V = bool(operand & 0b0100'0000);
-                P.Z = (A & operand) == 0;
-                break;
-            case 0x00: // BRK
-                P.I = 1;
-                push(address{ PC + 2 });
-                push(P.value);
-                break;
-            case 0x4C: // JMP absolute
-                PC = address{ operands.first, operands.second };
-                break;
-            case 0x6C: // JMP indirect
-                PC = address{ memory.read(address{ operands.first, operands.second }),
-                              memory.read(address{ operands.first, operands.second } + 1) };
-                break;
-            case 0x20: // JSR
-                push(address{ PC + 2 });
-                PC = address{ operands.first, operands.second };
-                break;
-            case 0xEA: // NOP
-                break;
-            case 0x48: // PHA
-                push(A);
-                break;
-            case 0x08: // PHP
-                push(P.value);
-                break;
-            case 0x68: // PLA
-                A = pull();
-                P.N = bool(A & 0b1000'0000);
-                P.Z = A == 0;
-                break;
-            case 0x28: // PLP
-                P.value = pull();
-                P.I = 0;
-                break;
-            case 0x40: // RTI
-                P.value = pull();
-                P.I = 0;
-                PC = pull_address();
-                break;
-            case 0x60: // RTS
-                PC = pull_address();
-                break;
-            case 0xAA: // TAX
-                X = A;
-                P.N = bool(X & 0b1000'0000);
-                P.Z = X == 0;
-                break;
-            case 0xA8: // TAY
-                Y = A;
-                P.N = bool(Y & 0b1000'0000);
-                P.Z = Y == 0;
-                break;
-            case 0x8A: // TXA
-                A = X;
-                P.N = bool(A & 0b1000'0000);
-                P.Z = A == 0;
-                break;
-            case 0x98: // TYA
-                A = Y;
-                P.N = bool(A & 0b1000'0000);
-                P.Z = A == 0;
-                break;
-            case 0xBA: // TSX
-                X = S;
-                P.N = bool(X & 0b1000'0000);
-                P.Z = X == 0;
-                break;
-            case 0x9A: // TXS
-                S = X;
-                break;
-            default: // Later "illegal" opcodes.
-                break;
+                interrupt(0xFFFE);
             }
+        };
+
+        // Runs until at least the given cycle.
+        // Nothing outside the CPU happens before
+        // then, so idle loops can be skipped up
+        // to it.
+        void run_until(uint64_t limit);
 
+        template <bool check_breakpoints>
+        void run();
 
+        // Take the RESET vector. The real chip does
+        // three fake pushes here, so S drops by 3
+        // without anything being written.
+        void reset()
+        {
+            jammed = false;
+            S -= 3;
+            P.I = 1;
+            PC = address{ memory.read(0xFFFC), memory.read(0xFFFD) };
+            cycles += 7;
         };
     };
-};
\ No newline at end of file
+
+    extern template struct basic_cpu<ntsc>;
+    extern template struct basic_cpu<pal>;
+    extern template struct basic_cpu<dendy>;
+
+    using cpu = basic_cpu<ntsc>;
+};
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+#include "fundamentals.hpp"
+#include "system.hpp"
+
+namespace emulatte
+{
+    // Breakpoints, watchpoints and single-stepping,
+    // attached to a system for as long as this is
+    // alive.
+    //
+    // None of it costs anything where it isn't
+    // used. Watchpoints take their pages out of
+    // the bus page table, so only accesses to a
+    // watched page go the slow way round and get
+    // checked - everything else still reads and
+    // writes memory directly. Breakpoints are a
+    // bit per address that the CPU only looks at
+    // when there are any, with its own copy of
+    // the run loop that does the looking.
+    template <typename Region>
+    class basic_debugger
+    {
+    public:
+        enum class stop_reason
+        {
+            None,
+            Breakpoint,
+            Watchpoint,
+            Step,
+            FrameEnd,
+        };
+
+        // Why we last handed control back. For a
+        // watchpoint, which access set it off.
+        struct stop
+        {
+            stop_reason reason = stop_reason::None;
+            word address = 0;
+            byte value = 0;
+            bool write = false;
+        };
+
+        explicit basic_debugger(basic_system<Region>& nes) :
+            nes{ nes },
+            skipped_idle_loops{ nes.processor.skip_idle_loops }
+        {
+            nes.processor.memory.on_watch = [this](word addy, byte value, bool write)
+            {
+                watched(addy, value, write);
+            };
+        };
+
+        ~basic_debugger()
+        {
+            auto& memory = nes.processor.memory;
+            for (int page = 0; page < 0x100; ++page)
+            {
+                memory.watch_page(byte(page), false, false);
+            }
+            memory.on_watch = nullptr;
+            nes.processor.breakpoints = nullptr;
+            nes.processor.stop_requested = false;
+            nes.processor.skip_idle_loops = skipped_idle_loops;
+        };
+
+        basic_debugger(const basic_debugger&) = delete;
+        basic_debugger& operator=(const basic_debugger&) = delete;
+
+        void add_breakpoint(word pc)
+        {
+            if (!breakpoints.test(pc))
+            {
+                breakpoints.set(pc);
+                ++breakpoint_count;
+            }
+            update();
+        };
+
+        void remove_breakpoint(word pc)
+        {
+            if (breakpoints.test(pc))
+            {
+                breakpoints.reset(pc);
+                --breakpoint_count;
+            }
+            update();
+        };
+
+        // Watches first-last (inclusive) for reads,
+        // writes or both. Gives back an id to
+        // remove it with.
+        int add_watchpoint(word first, word last, bool reads, bool writes)
+        {
+            watchpoints.push_back({ first, last, reads, writes, true });
+            update();
+            return int(watchpoints.size()) - 1;
+        };
+
+        void remove_watchpoint(int id)
+        {
+            if (id >= 0 && id < int(watchpoints.size()))
+            {
+                watchpoints[id].active = false;
+            }
+            update();
+        };
+
+        // Runs until the end of the frame, or until
+        // something we're watching for happens. The
+        // next call picks up where this one stopped.
+        stop run_frame()
+        {
+            resume();
+            nes.run_frame();
+            if (!nes.processor.stop_requested)
+            {
+                last = { stop_reason::FrameEnd };
+            }
+            else if (last.reason == stop_reason::None)
+            {
+                last = { stop_reason::Breakpoint, nes.processor.PC.value };
+            }
+            return last;
+        };
+
+        // Runs one instruction. Watchpoints it sets
+        // off are still reported. Just the one: if
+        // it's the branch closing an idle loop, the
+        // rest of the loop isn't skipped over.
+        stop step()
+        {
+            resume();
+            auto& processor = nes.processor;
+            bool skipping = processor.skip_idle_loops;
+            processor.skip_idle_loops = false;
+            nes.step_instruction();
+            processor.skip_idle_loops = skipping;
+            if (last.reason == stop_reason::None)
+            {
+                last = { stop_reason::Step, nes.processor.PC.value };
+            }
+            return last;
+        };
+
+        const stop& last_stop() const
+        {
+            return last;
+        };
+
+    private:
+        struct watchpoint
+        {
+            word first;
+            word last;
+            bool reads;
+            bool writes;
+            bool active;
+        };
+
+        // Clears the last stop. Carrying on always
+        // runs the instruction we're sitting on,
+        // even if there's a breakpoint on it.
+        void resume()
+        {
+            auto& processor = nes.processor;
+            processor.resume_from = processor.PC.value;
+            processor.stop_requested = false;
+            last = {};
+        };
+
+        // Whether a watch covers an address. The
+        // 2KB of RAM shows up four times below
+        // $2000, so a watch on any copy of a byte
+        // covers all of them.
+        static bool covers(const watchpoint& watch, word addy)
+        {
+            if (addy >= 0x2000)
+            {
+                return addy >= watch.first && addy <= watch.last;
+            }
+            for (int mirror = addy & 0x7FF; mirror < 0x2000; mirror += 0x800)
+            {
+                if (mirror >= watch.first && mirror <= watch.last)
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        void watched(word addy, byte value, bool write)
+        {
+            for (const watchpoint& watch : watchpoints)
+            {
+                if (watch.active && (write ? watch.writes : watch.reads) && covers(watch, addy))
+                {
+                    // Let the instruction finish, and
+                    // stop straight after it.
+                    last = { stop_reason::Watchpoint, addy, value, write };
+                    nes.processor.stop_requested = true;
+                    nes.processor.run_limit = 0;
+                    return;
+                }
+            }
+        };
+
+        // Works out which pages need trapping, and
+        // whether the CPU needs to look for
+        // breakpoints at all.
+        void update()
+        {
+            std::bitset<0x100> read_pages;
+            std::bitset<0x100> write_pages;
+            for (const watchpoint& watch : watchpoints)
+            {
+                if (!watch.active)
+                {
+                    continue;
+                }
+                for (int page = watch.first >> 8; page <= watch.last >> 8; ++page)
+                {
+                    // RAM pages are trapped in every
+                    // mirror, whichever one was asked for.
+                    int mirrors = page < 0x20 ? 4 : 1;
+                    for (int mirror = 0; mirror < mirrors; ++mirror)
+                    {
+                        int trapped = page < 0x20 ? (page & 0x07) | (mirror << 3) : page;
+                        read_pages[trapped] = read_pages[trapped] || watch.reads;
+                        write_pages[trapped] = write_pages[trapped] || watch.writes;
+                    }
+                }
+            }
+
+            auto& memory = nes.processor.memory;
+            for (int page = 0; page < 0x100; ++page)
+            {
+                if (memory.watched_reads[page] != read_pages[page] || memory.watched_writes[page] != write_pages[page])
+                {
+                    memory.watch_page(byte(page), read_pages[page], write_pages[page]);
+                }
+            }
+
+            nes.processor.breakpoints = breakpoint_count ? &breakpoints : nullptr;
+            // Skipping an idle loop skips its reads
+            // too, and jumps past its instructions,
+            // so while anything could be waiting on
+            // those we have to run every pass.
+            nes.processor.skip_idle_loops = skipped_idle_loops && !breakpoint_count && read_pages.none();
+        };
+
+        basic_system<Region>& nes;
+        bool skipped_idle_loops;
+        std::bitset<0x10000> breakpoints;
+        int breakpoint_count = 0;
+        std::vector<watchpoint> watchpoints;
+        stop last;
+    };
+
+    using debugger = basic_debugger<ntsc>;
+};
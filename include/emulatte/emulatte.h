@@ -0,0 +1,135 @@
+#pragma once
+
+/*
+ * A plain C interface to the emulator, so that
+ * it can be driven from other languages without
+ * a C++ compiler in the loop. Everything is kept
+ * to opaque handles, fixed-width integers and
+ * caller-owned buffers: nothing here allocates
+ * once a system has been created, and the layout
+ * of what we expose won't change underneath you.
+ *
+ * Functions that can fail return 0 on success
+ * and a negative EMULATTE_ERROR_* value if not.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(EMULATTE_BUILDING_LIBRARY)
+#    define EMULATTE_API __declspec(dllexport)
+#  else
+#    define EMULATTE_API __declspec(dllimport)
+#  endif
+#else
+#  define EMULATTE_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped whenever a signature below changes. */
+#define EMULATTE_API_VERSION 1
+
+#define EMULATTE_SCREEN_WIDTH 256
+#define EMULATTE_SCREEN_HEIGHT 240
+#define EMULATTE_FRAMEBUFFER_SIZE (EMULATTE_SCREEN_WIDTH * EMULATTE_SCREEN_HEIGHT)
+#define EMULATTE_RAM_SIZE 0x800
+
+#define EMULATTE_OK 0
+#define EMULATTE_ERROR_ARGUMENT -1
+#define EMULATTE_ERROR_ROM -2
+#define EMULATTE_ERROR_SNAPSHOT -3
+
+/*
+ * The kinds of console, which decide all of the
+ * timing: NTSC (America and Japan), PAL (Europe)
+ * and Dendy (the PAL famiclones).
+ */
+#define EMULATTE_REGION_NTSC  0
+#define EMULATTE_REGION_PAL   1
+#define EMULATTE_REGION_DENDY 2
+
+/* Controller bits, in the order the pad shifts them out. */
+#define EMULATTE_BUTTON_A      0x01
+#define EMULATTE_BUTTON_B      0x02
+#define EMULATTE_BUTTON_SELECT 0x04
+#define EMULATTE_BUTTON_START  0x08
+#define EMULATTE_BUTTON_UP     0x10
+#define EMULATTE_BUTTON_DOWN   0x20
+#define EMULATTE_BUTTON_LEFT   0x40
+#define EMULATTE_BUTTON_RIGHT  0x80
+
+typedef struct emulatte_system emulatte_system;
+
+EMULATTE_API int emulatte_api_version(void);
+
+/*
+ * Returns NULL if we're out of memory, or if the
+ * region isn't one of EMULATTE_REGION_*. Plain
+ * emulatte_create() makes an NTSC system.
+ */
+EMULATTE_API emulatte_system* emulatte_create(void);
+EMULATTE_API emulatte_system* emulatte_create_region(int region);
+EMULATTE_API void emulatte_destroy(emulatte_system* system);
+
+/*
+ * Every call below takes a NULL system quietly:
+ * the ones returning a status give back
+ * EMULATTE_ERROR_ARGUMENT, the rest do nothing
+ * and return 0 or NULL.
+ */
+EMULATTE_API int emulatte_region(const emulatte_system* system);
+
+EMULATTE_API int emulatte_load_rom(emulatte_system* system, const char* path);
+EMULATTE_API void emulatte_reset(emulatte_system* system);
+
+/* port is 0 or 1, buttons is a mask of EMULATTE_BUTTON_*. */
+EMULATTE_API void emulatte_set_input(emulatte_system* system, int port, uint8_t buttons);
+
+/*
+ * Runs `frames` frames in one call. Every buffer
+ * is optional (pass NULL to skip it):
+ *
+ *   inputs  frames * 2 bytes, the buttons for
+ *           port 0 and port 1 before each frame.
+ *   pixels  frames * EMULATTE_FRAMEBUFFER_SIZE
+ *           bytes, filled with each frame's
+ *           palette indices.
+ *   ram     frames * EMULATTE_RAM_SIZE bytes,
+ *           filled with RAM after each frame.
+ *
+ * Returns the total number of frames run so far.
+ */
+EMULATTE_API uint64_t emulatte_step(emulatte_system* system, uint32_t frames,
+                                    const uint8_t* inputs, uint8_t* pixels, uint8_t* ram);
+
+/*
+ * Views straight into the live system. They stay
+ * valid until the system is destroyed, and always
+ * show the most recent frame.
+ */
+EMULATTE_API const uint8_t* emulatte_framebuffer(const emulatte_system* system);
+EMULATTE_API const uint8_t* emulatte_ram(const emulatte_system* system);
+
+/*
+ * Save states go into caller-owned buffers of
+ * emulatte_snapshot_size() bytes. Each starts
+ * with a small header naming the API version and
+ * region it came from; restoring one into a
+ * system of another region, or from another
+ * version, or one that's been damaged badly
+ * enough to be unusable, fails with
+ * EMULATTE_ERROR_SNAPSHOT and leaves the system
+ * alone. They're still only meant for a system
+ * running the same ROM.
+ */
+EMULATTE_API size_t emulatte_snapshot_size(void);
+EMULATTE_API int emulatte_snapshot(const emulatte_system* system, void* buffer, size_t size);
+EMULATTE_API int emulatte_restore(emulatte_system* system, const void* buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
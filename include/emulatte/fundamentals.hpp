@@ -12,9 +12,11 @@ namespace emulatte
     using byte = uint8_t;
     using word = uint16_t;
 
-    // Simple wrapper for a word that will handle
-    // CPU memory mapping automatically when it is
-    // converted.
+    // Simple wrapper for a word, so addresses can
+    // be built from the Lo-Hi byte pairs the CPU
+    // reads them as. Mirroring used to be handled
+    // here too, but that's the bus's page table's
+    // job now.
     struct address
     {
         word value = 0x0000;
@@ -33,20 +35,9 @@ namespace emulatte
         // to treat an address almost exactly like
         // a word, while letting us have this extra
         // functionality.
-        operator word()
+        operator word() const
         {
-            if (value >= 0x0800 && value < 0x2000)
-            {
-                return value % 0x0800;
-            }
-            else if (value >= 0x2008 && value < 0x4000)
-            {
-                return value % 8 + 0x2000;
-            }
-            else
-            {
-                return value;
-            }
+            return value;
         };
     };
 };
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+#include "fundamentals.hpp"
+
+namespace emulatte
+{
+    // Memory that copies of a system share until
+    // one of them writes to it, a page at a time.
+    // The CPU's bus (see basic_cpu::bus) and the
+    // PPU both keep their bigger memories like
+    // this, so a copy only costs a pointer per
+    // page, and each side only pays for the pages
+    // it goes on to change.
+    using memory_page = std::array<byte, 0x100>;
+
+    // All pages start out as this one, until
+    // something is loaded or written there.
+    inline const std::shared_ptr<memory_page>& blank_page()
+    {
+        static const std::shared_ptr<memory_page> blank = std::make_shared<memory_page>();
+        return blank;
+    };
+
+    // Makes sure a page is ours alone before it's
+    // written, copying it if anyone else still has
+    // it, and gives back where it now lives. This
+    // is the only place that checks, so whoever
+    // writes a shared page has to come through
+    // here every time - never hold on to what it
+    // returns past the write.
+    inline byte* own_page(std::shared_ptr<memory_page>& block)
+    {
+        if (block.use_count() > 1)
+        {
+            block = std::make_shared<memory_page>(*block);
+        }
+        else
+        {
+            // Whoever dropped the last other
+            // reference might have been copying it
+            // on another thread; make sure they're
+            // done with it.
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return block->data();
+    };
+};
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+#include "fundamentals.hpp"
+#include "memory_page.hpp"
+
+namespace emulatte
+{
+    // Everything the PPU holds apart from its
+    // nametables and CHR: the registers, and the
+    // small memories that are copied outright.
+    // It's all plain data, so snapshots can take
+    // it as it is.
+    struct ppu_state
+    {
+        // $2000-$2002.
+        byte control = 0x00;
+        byte mask = 0x00;
+        byte status = 0x00;
+        // $2003, where $2004 reads and writes OAM.
+        byte oam_address = 0x00;
+        // The internal scroll registers: the current
+        // VRAM address (v), the temporary one (t),
+        // fine X, and which half of a $2005/$2006
+        // write we're on (w).
+        word v = 0x0000;
+        word t = 0x0000;
+        byte fine_x = 0;
+        bool w = false;
+        // $2007 reads come back one read late,
+        // except from the palette.
+        byte read_buffer = 0x00;
+        // The last value written to any register,
+        // which is what unused bits read back as.
+        byte latch = 0x00;
+        bool vertical_mirroring = false;
+        // Rounds the registers up to an even size,
+        // so the word above doesn't leave a byte of
+        // padding at the end for snapshots to carry.
+        byte unused = 0x00;
+
+        std::array<byte, 0x100> oam = {};
+        std::array<byte, 0x20> palette = {};
+    };
+
+    // The picture processing unit, as far as the
+    // CPU can see it: its eight registers, the
+    // memory behind them, and the vblank flag.
+    // Nothing is drawn yet.
+    struct ppu : ppu_state
+    {
+        // There are 341 dots to a scanline whatever
+        // the region; how many scanlines make up a
+        // frame, and where vblank falls in them, is
+        // up to the region (see region.hpp).
+        static constexpr uint64_t dots_per_scanline = 341;
+
+        // The two 1KB nametables, and the
+        // cartridge's CHR - NROM only has 8KB of it
+        // (or of RAM, if the cart has no ROM). They
+        // are shared page by page with copies of us,
+        // the same way as the CPU's memory, so a
+        // copy doesn't cost 10KB.
+        std::array<std::shared_ptr<memory_page>, 0x08> nametables;
+        std::array<std::shared_ptr<memory_page>, 0x20> patterns;
+
+        ppu()
+        {
+            nametables.fill(blank_page());
+            patterns.fill(blank_page());
+        };
+
+        // Whether the PPU is pulling NMI low right
+        // now. The CPU only cares about it going
+        // from off to on.
+        bool nmi_output() const
+        {
+            return (control & 0x80) && (status & 0x80);
+        };
+
+        // Reads register 0-7. Anything that changes
+        // our state bumps side_effects, so idle
+        // loops polling us notice.
+        byte read(word reg, uint64_t& side_effects)
+        {
+            switch (reg & 7)
+            {
+            case 2:
+            {
+                byte value = (status & 0xE0) | (latch & 0x1F);
+                if ((status & 0x80) || w)
+                {
+                    ++side_effects;
+                }
+                status &= 0x7F;
+                w = false;
+                latch = value;
+                return value;
+            }
+            case 4:
+                latch = oam[oam_address];
+                return latch;
+            case 7:
+            {
+                byte value = read_buffer;
+                read_buffer = read_vram(v);
+                if ((v & 0x3FFF) >= 0x3F00)
+                {
+                    // Palette reads skip the buffer, but
+                    // it gets refilled from the nametable
+                    // "underneath" it.
+                    value = read_vram(v);
+                    read_buffer = read_vram(v - 0x1000);
+                }
+                v += (control & 0x04) ? 32 : 1;
+                ++side_effects;
+                latch = value;
+                return value;
+            }
+            default:
+                return latch;
+            }
+        };
+
+        // Writes register 0-7. Returns true if this
+        // write is what turned NMI on - enabling it
+        // in the middle of vblank fires one right
+        // away.
+        bool write(word reg, byte value)
+        {
+            bool was_asserting = nmi_output();
+            latch = value;
+            switch (reg & 7)
+            {
+            case 0:
+                control = value;
+                t = (t & 0xF3FF) | (word(value & 0x03) << 10);
+                break;
+            case 1:
+                mask = value;
+                break;
+            case 3:
+                oam_address = value;
+                break;
+            case 4:
+                oam[oam_address++] = value;
+                break;
+            case 5:
+                if (!w)
+                {
+                    t = (t & 0xFFE0) | (value >> 3);
+                    fine_x = value & 0x07;
+                }
+                else
+                {
+                    t = (t & 0x8C1F) | (word(value & 0x07) << 12) | (word(value & 0xF8) << 2);
+                }
+                w = !w;
+                break;
+            case 6:
+                if (!w)
+                {
+                    t = (t & 0x00FF) | (word(value & 0x3F) << 8);
+                }
+                else
+                {
+                    t = (t & 0xFF00) | value;
+                    v = t;
+                }
+                w = !w;
+                break;
+            case 7:
+                write_vram(v, value);
+                v += (control & 0x04) ? 32 : 1;
+                break;
+            default:
+                break;
+            }
+            return !was_asserting && nmi_output();
+        };
+
+        // The PPU's own 14-bit address space. Below
+        // $3F00 it's pages, which we have to own
+        // before writing; the palette is ours.
+        byte read_vram(word addy) const
+        {
+            addy &= 0x3FFF;
+            if (addy < 0x2000)
+            {
+                return (*patterns[addy >> 8])[addy & 0xFF];
+            }
+            else if (addy < 0x3F00)
+            {
+                word offset = nametable_offset(addy);
+                return (*nametables[offset >> 8])[offset & 0xFF];
+            }
+            return palette[palette_offset(addy)];
+        };
+
+        void write_vram(word addy, byte value)
+        {
+            addy &= 0x3FFF;
+            if (addy < 0x2000)
+            {
+                own_page(patterns[addy >> 8])[addy & 0xFF] = value;
+            }
+            else if (addy < 0x3F00)
+            {
+                word offset = nametable_offset(addy);
+                own_page(nametables[offset >> 8])[offset & 0xFF] = value;
+            }
+            else
+            {
+                palette[palette_offset(addy)] = value;
+            }
+        };
+
+        // Two 1KB nametables, mirrored across the
+        // four slots the PPU can address.
+        word nametable_offset(word addy) const
+        {
+            word table = (addy >> 10) & 3;
+            word page = vertical_mirroring ? (table & 1) : (table >> 1);
+            return page * 0x400 + (addy & 0x3FF);
+        };
+
+        // The backdrop entries of the sprite
+        // palettes are the background ones.
+        static word palette_offset(word addy)
+        {
+            addy &= 0x1F;
+            if ((addy & 0x13) == 0x10)
+            {
+                addy &= 0x0F;
+            }
+            return addy;
+        };
+    };
+};
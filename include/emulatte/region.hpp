@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace emulatte
+{
+    // The timing of the different kinds of
+    // console. They're used as template arguments,
+    // so every one of these is a constant wherever
+    // it ends up, and a PAL system has its numbers
+    // folded into its own code rather than looking
+    // them up at run time.
+    //
+    // Each one says how the master clock is
+    // divided down for the CPU and PPU, how the
+    // PPU's frame is laid out in scanlines, and
+    // the APU's periods, in CPU cycles.
+
+    // The American and Japanese consoles.
+    struct ntsc
+    {
+        static constexpr const char* name = "ntsc";
+
+        static constexpr uint64_t cpu_divider = 12;
+        static constexpr uint64_t ppu_divider = 4;
+
+        // 240 visible lines and one idle one, then
+        // vblank until the pre-render line, which is
+        // always the last one.
+        static constexpr uint64_t scanlines_per_frame = 262;
+        static constexpr uint64_t vblank_scanline = 241;
+
+        // In 4-step mode the frame IRQ comes around
+        // every 29830 CPU cycles, the first one
+        // 29829 cycles after $4017 is written.
+        static constexpr uint64_t frame_irq_first = 29829;
+        static constexpr uint64_t frame_irq_period = 29830;
+
+        // How many CPU cycles the DMC waits between
+        // output bits, for each rate in $4010.
+        static constexpr std::array<uint16_t, 16> dmc_rates = {
+            428, 380, 340, 320, 286, 254, 226, 214, 190, 160, 142, 128, 106, 84, 72, 54,
+        };
+    };
+
+    // The European consoles. The CPU is divided
+    // down further, to 3.2 PPU dots a cycle, and
+    // vblank is a lot longer.
+    struct pal
+    {
+        static constexpr const char* name = "pal";
+
+        static constexpr uint64_t cpu_divider = 16;
+        static constexpr uint64_t ppu_divider = 5;
+
+        static constexpr uint64_t scanlines_per_frame = 312;
+        static constexpr uint64_t vblank_scanline = 241;
+
+        static constexpr uint64_t frame_irq_first = 33253;
+        static constexpr uint64_t frame_irq_period = 33254;
+
+        static constexpr std::array<uint16_t, 16> dmc_rates = {
+            398, 354, 316, 298, 276, 236, 210, 198, 176, 148, 132, 118, 98, 78, 66, 50,
+        };
+    };
+
+    // The Dendy and the other famiclones made for
+    // PAL televisions. They have PAL's 312 lines,
+    // but keep NTSC's 3 dots to a CPU cycle, and
+    // put vblank 50 lines later so games written
+    // for NTSC get as long to draw as they expect.
+    // The APU is the NTSC one.
+    struct dendy
+    {
+        static constexpr const char* name = "dendy";
+
+        static constexpr uint64_t cpu_divider = 15;
+        static constexpr uint64_t ppu_divider = 5;
+
+        static constexpr uint64_t scanlines_per_frame = 312;
+        static constexpr uint64_t vblank_scanline = 291;
+
+        static constexpr uint64_t frame_irq_first = ntsc::frame_irq_first;
+        static constexpr uint64_t frame_irq_period = ntsc::frame_irq_period;
+
+        static constexpr std::array<uint16_t, 16> dmc_rates = ntsc::dmc_rates;
+    };
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <semaphore>
+#include <thread>
+
+#include "fundamentals.hpp"
+#include "system.hpp"
+
+namespace emulatte
+{
+    using framebuffer_type = decltype(system::framebuffer);
+
+    // Most games only react to input a frame or
+    // two after reading it. Run-ahead hides that
+    // lag: after every real frame we save the
+    // state, keep going a few frames with the
+    // same input, show what comes out, and then
+    // put the state back as if nothing happened.
+    //
+    // This relies on snapshots being cheap, and
+    // they are - a system::snapshot is a fixed
+    // block that save() and restore() just copy
+    // into, so nothing here allocates per frame.
+    //
+    // The frames ahead never happen as far as the
+    // save file is concerned: PRG-RAM is moved off
+    // it while they run, onto a spare block made
+    // along with the save file, and back once the
+    // state is put back - by then it holds what
+    // the file does, so the file isn't touched.
+    template <typename Region>
+    class basic_run_ahead
+    {
+    public:
+        basic_run_ahead(basic_system<Region>& nes, int frames) :
+            nes{ nes },
+            frames{ frames }
+        {};
+
+        // Runs one real frame with the given input,
+        // then leaves the frame that would appear
+        // `frames` frames from now in framebuffer().
+        void run_frame(byte port0, byte port1)
+        {
+            nes.set_input(0, port0);
+            nes.set_input(1, port1);
+            nes.run_frame();
+            if (frames <= 0)
+            {
+                output = nes.framebuffer;
+                return;
+            }
+
+            nes.save(saved);
+            nes.detach_battery();
+            for (int i = 0; i < frames; ++i)
+            {
+                nes.run_frame();
+            }
+            output = nes.framebuffer;
+            nes.restore(saved);
+            nes.attach_battery();
+        };
+
+        const framebuffer_type& framebuffer() const
+        {
+            return output;
+        };
+
+    private:
+        basic_system<Region>& nes;
+        int frames;
+        typename basic_system<Region>::snapshot saved;
+        framebuffer_type output = {};
+    };
+
+    // The same idea, but the frames ahead are run
+    // on a second system on its own thread, so the
+    // real system never rewinds and the two run
+    // side by side on separate cores. The real one
+    // still saves its state after every frame, for
+    // the worker to start from next time, but that
+    // is a copy into a slot that's already there.
+    //
+    // The second system is a fork, and forks never
+    // get the save file, so nothing it runs ahead
+    // can end up in there.
+    //
+    // Each frame the worker picks up the state
+    // the real system was in at the start of the
+    // frame, catches up on the frame the real one
+    // is running right now, and then runs ahead.
+    // run_frame() returns once both are done.
+    template <typename Region>
+    class basic_threaded_run_ahead
+    {
+    public:
+        basic_threaded_run_ahead(basic_system<Region>& nes, int frames) :
+            nes{ nes },
+            ahead{ nes.fork() },
+            frames{ frames }
+        {
+            nes.save(states[0]);
+            worker = std::jthread{ [this](std::stop_token stop) { work(stop); } };
+        };
+
+        ~basic_threaded_run_ahead()
+        {
+            worker.request_stop();
+            start.release();
+        };
+
+        basic_threaded_run_ahead(const basic_threaded_run_ahead&) = delete;
+        basic_threaded_run_ahead& operator=(const basic_threaded_run_ahead&) = delete;
+
+        void run_frame(byte port0, byte port1)
+        {
+            input = { port0, port1 };
+            start.release();
+
+            nes.set_input(0, port0);
+            nes.set_input(1, port1);
+            nes.run_frame();
+            // The worker is still reading the other
+            // slot, so this one is ours to fill.
+            nes.save(states[current ^ 1]);
+
+            done.acquire();
+            current ^= 1;
+        };
+
+        const framebuffer_type& framebuffer() const
+        {
+            return output;
+        };
+
+    private:
+        void work(std::stop_token stop)
+        {
+            while (true)
+            {
+                start.acquire();
+                if (stop.stop_requested())
+                {
+                    return;
+                }
+
+                ahead->restore(states[current]);
+                ahead->set_input(0, input[0]);
+                ahead->set_input(1, input[1]);
+                for (int i = 0; i <= frames; ++i)
+                {
+                    ahead->run_frame();
+                }
+                output = ahead->framebuffer;
+                done.release();
+            }
+        };
+
+        basic_system<Region>& nes;
+        std::unique_ptr<basic_system<Region>> ahead;
+        int frames;
+        // Two slots, so the real system can save
+        // the end of this frame while the worker is
+        // still restoring from the start of it.
+        std::array<typename basic_system<Region>::snapshot, 2> states;
+        int current = 0;
+        std::array<byte, 2> input = {};
+        framebuffer_type output = {};
+        std::binary_semaphore start{ 0 };
+        std::binary_semaphore done{ 0 };
+        std::jthread worker;
+    };
+
+    using run_ahead = basic_run_ahead<ntsc>;
+    using threaded_run_ahead = basic_threaded_run_ahead<ntsc>;
+};
@@ -0,0 +1,271 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <utility>
+
+#include "fundamentals.hpp"
+#include "region.hpp"
+
+namespace emulatte
+{
+    // The things a scheduler keeps track of. They
+    // are the same whatever the region, so its
+    // queue can be saved and restored the same
+    // way everywhere.
+    struct scheduler_events
+    {
+        static constexpr uint64_t never = ~uint64_t(0);
+
+        // Everything that can happen on its own.
+        // Each kind is pending at most once, so
+        // scheduling one that's already pending
+        // just moves it.
+        enum class event : byte
+        {
+            // The PPU has finished a frame.
+            FrameEnd,
+            // The PPU enters vblank, setting the
+            // status flag and maybe firing an NMI.
+            VblankStart,
+            // The pre-render line clears vblank.
+            VblankEnd,
+            // Something turned NMIs on in the middle
+            // of vblank, which fires one straight
+            // away.
+            Nmi,
+            // The APU frame counter raises its IRQ.
+            FrameIrq,
+            // $4014 was written, and the CPU halts
+            // while a page is copied into OAM.
+            OamDma,
+            Count,
+        };
+        static constexpr int event_count = int(event::Count);
+
+        // The pending events, as a binary min-heap
+        // ordered by time. Each kind also remembers
+        // where it sits in the heap, so moving or
+        // cancelling one is O(log n) and nothing
+        // is ever allocated. It's plain data, so
+        // it can go straight into a snapshot, and
+        // the padding is spelled out so that every
+        // byte of it is always set (see
+        // hash_state).
+        struct queue
+        {
+            struct entry
+            {
+                uint64_t time = never;
+                event type = event::Count;
+                std::array<byte, 7> unused = {};
+            };
+            std::array<entry, event_count> heap = {};
+            std::array<int8_t, event_count> position = {};
+            int16_t size = 0;
+
+            // Whether the heap and the positions agree
+            // with each other, and stay inside the
+            // arrays. The scheduler indexes by both
+            // without checking, so a queue from outside
+            // (a snapshot handed to the C API, say)
+            // has to pass this before it's used.
+            bool is_valid() const
+            {
+                if (size < 0 || size > event_count)
+                {
+                    return false;
+                }
+                for (int index = 0; index < size; ++index)
+                {
+                    int type = int(heap[index].type);
+                    if (type >= event_count || position[type] != index)
+                    {
+                        return false;
+                    }
+                }
+                int listed = 0;
+                for (int8_t index : position)
+                {
+                    if (index < -1 || index >= size)
+                    {
+                        return false;
+                    }
+                    listed += index >= 0;
+                }
+                return listed == size;
+            };
+        };
+    };
+
+    // Keeps track of when everything outside the
+    // CPU next needs attention, and owns the clock
+    // all of that is measured against.
+    //
+    // Time is counted in master clock ticks. The
+    // CPU and PPU are both divided down from the
+    // same crystal, and counting in its ticks is
+    // the only way to keep them exactly in step:
+    // on NTSC a CPU cycle is 12 ticks and a PPU
+    // dot is 4, and the region says what they
+    // are elsewhere.
+    //
+    // The CPU itself doesn't advance the clock,
+    // it just counts its own cycles. The clock
+    // reads that count when it needs to, and
+    // tells the CPU how far it may run before
+    // something else is due - so the CPU runs
+    // whole batches of instructions without
+    // looking at anything else.
+    template <typename Region>
+    class basic_scheduler : public scheduler_events
+    {
+    public:
+        static constexpr uint64_t cpu_divider = Region::cpu_divider;
+        static constexpr uint64_t ppu_divider = Region::ppu_divider;
+
+        basic_scheduler()
+        {
+            pending.position.fill(-1);
+        };
+
+        // Hooks us up to the CPU's cycle counter,
+        // which is where "now" comes from, and to
+        // the limit it's allowed to run up to, which
+        // we pull in whenever something new is due
+        // sooner than that.
+        void attach(const uint64_t& cycles, uint64_t& limit)
+        {
+            cpu_cycles = &cycles;
+            cpu_limit = &limit;
+        };
+
+        uint64_t now() const
+        {
+            return *cpu_cycles * cpu_divider;
+        };
+
+        void schedule(event type, uint64_t time)
+        {
+            int index = pending.position[int(type)];
+            if (index < 0)
+            {
+                index = pending.size++;
+                pending.heap[index] = { never, type };
+                pending.position[int(type)] = index;
+            }
+            uint64_t previous = pending.heap[index].time;
+            pending.heap[index].time = time;
+            time < previous ? sift_up(index) : sift_down(index);
+
+            if (cpu_limit)
+            {
+                *cpu_limit = std::min(*cpu_limit, cpu_deadline());
+            }
+        };
+
+        void cancel(event type)
+        {
+            int index = pending.position[int(type)];
+            if (index < 0)
+            {
+                return;
+            }
+            pending.position[int(type)] = -1;
+            if (--pending.size != index)
+            {
+                move(index, pending.heap[pending.size]);
+                sift_up(index);
+                sift_down(index);
+            }
+        };
+
+        bool is_pending(event type) const
+        {
+            return pending.position[int(type)] >= 0;
+        };
+
+        uint64_t next_time() const
+        {
+            return pending.size ? pending.heap[0].time : never;
+        };
+
+        // The first CPU cycle at which the next
+        // event is due.
+        uint64_t cpu_deadline() const
+        {
+            uint64_t time = next_time();
+            return time == never ? never : (time + cpu_divider - 1) / cpu_divider;
+        };
+
+        // Takes the next event off the queue if its
+        // time has come, giving back when it was due
+        // so it can be rescheduled relative to that.
+        bool pop_due(event& type, uint64_t& time)
+        {
+            if (!pending.size || pending.heap[0].time > now())
+            {
+                return false;
+            }
+            type = pending.heap[0].type;
+            time = pending.heap[0].time;
+            cancel(type);
+            return true;
+        };
+
+        queue pending;
+
+    private:
+        void move(int index, queue::entry item)
+        {
+            pending.heap[index] = item;
+            pending.position[int(item.type)] = index;
+        };
+
+        void sift_up(int index)
+        {
+            queue::entry item = pending.heap[index];
+            while (index > 0)
+            {
+                int parent = (index - 1) / 2;
+                if (pending.heap[parent].time <= item.time)
+                {
+                    break;
+                }
+                move(index, pending.heap[parent]);
+                index = parent;
+            }
+            move(index, item);
+        };
+
+        void sift_down(int index)
+        {
+            queue::entry item = pending.heap[index];
+            while (true)
+            {
+                int child = index * 2 + 1;
+                if (child >= pending.size)
+                {
+                    break;
+                }
+                if (child + 1 < pending.size && pending.heap[child + 1].time < pending.heap[child].time)
+                {
+                    ++child;
+                }
+                if (item.time <= pending.heap[child].time)
+                {
+                    break;
+                }
+                move(index, pending.heap[child]);
+                index = child;
+            }
+            move(index, item);
+        };
+
+        const uint64_t* cpu_cycles = nullptr;
+        uint64_t* cpu_limit = nullptr;
+    };
+
+    using scheduler = basic_scheduler<ntsc>;
+};
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "fundamentals.hpp"
+
+namespace emulatte
+{
+    // The layout of the POSIX shared memory object
+    // we publish frames into. Other processes map
+    // the same object and read straight out of it,
+    // so everything here is plain data with fixed
+    // sizes - don't reorder it without bumping the
+    // version.
+    //
+    // There are three slots. The publisher always
+    // writes the slot after the most recent one,
+    // so the latest frame stays untouched while
+    // the next one is written. Each slot carries a
+    // sequence number that is odd while it's being
+    // written: a reader notes it, reads the slot
+    // in place, and checks it again afterwards. If
+    // it changed, the publisher lapped the reader
+    // and it should just grab the latest again.
+    struct shared_frame
+    {
+        static constexpr uint32_t magic_value = 0x4554'4C55; // "ULTE"
+        static constexpr uint32_t version_value = 1;
+        static constexpr int width = 256;
+        static constexpr int height = 240;
+        static constexpr int ram_size = 0x800;
+        static constexpr int slot_count = 3;
+
+        struct slot
+        {
+            std::atomic<uint64_t> sequence;
+            uint64_t frame;
+            // Palette indices, one byte per pixel.
+            byte pixels[width * height];
+            byte ram[ram_size];
+        };
+
+        uint32_t magic;
+        uint32_t version;
+        // How many frames have been published, and
+        // which slot holds the newest one.
+        std::atomic<uint64_t> published;
+        std::atomic<uint32_t> latest;
+        // Keep the slots on their own cache lines,
+        // away from the header everyone polls.
+        alignas(64) slot slots[slot_count];
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+                  "shared_frame needs lock-free atomics to work across processes");
+
+    // Owns the shared memory object and writes
+    // finished frames into it.
+    class shared_frame_publisher
+    {
+    public:
+        shared_frame_publisher() = default;
+        shared_frame_publisher(const shared_frame_publisher&) = delete;
+        shared_frame_publisher& operator=(const shared_frame_publisher&) = delete;
+
+        ~shared_frame_publisher()
+        {
+            close();
+        };
+
+        // Creates (or takes over) the object with
+        // the given name, e.g. "/emulatte-0".
+        bool open(const std::string& object_name)
+        {
+            close();
+
+            int fd = shm_open(object_name.c_str(), O_CREAT | O_RDWR, 0644);
+            if (fd < 0)
+            {
+                return false;
+            }
+            if (ftruncate(fd, sizeof(shared_frame)) != 0)
+            {
+                ::close(fd);
+                shm_unlink(object_name.c_str());
+                return false;
+            }
+            void* mapping = mmap(nullptr, sizeof(shared_frame), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+            {
+                shm_unlink(object_name.c_str());
+                return false;
+            }
+
+            // A fresh object is all zeroes, which is a
+            // valid state for every atomic here. One
+            // left behind by an earlier run may have a
+            // slot it never finished writing, so we
+            // take it back to zeroes too - hiding it
+            // from readers first, by clearing the
+            // magic, so nobody reads it half cleared.
+            shared = static_cast<shared_frame*>(mapping);
+            shared->magic = 0;
+            std::atomic_thread_fence(std::memory_order_release);
+            std::memset(static_cast<void*>(shared), 0, sizeof(shared_frame));
+            shared->version = shared_frame::version_value;
+            // Readers check the magic last, so only
+            // write it once the rest is in place.
+            std::atomic_thread_fence(std::memory_order_release);
+            shared->magic = shared_frame::magic_value;
+            name = object_name;
+            return true;
+        };
+
+        void close()
+        {
+            if (shared)
+            {
+                munmap(shared, sizeof(shared_frame));
+                shm_unlink(name.c_str());
+                shared = nullptr;
+            }
+        };
+
+        bool is_open() const
+        {
+            return shared != nullptr;
+        };
+
+        void publish(uint64_t frame, const byte* pixels, const byte* ram)
+        {
+            uint32_t index = (shared->latest.load(std::memory_order_relaxed) + 1) % shared_frame::slot_count;
+            shared_frame::slot& target = shared->slots[index];
+
+            uint64_t sequence = target.sequence.load(std::memory_order_relaxed);
+            target.sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            target.frame = frame;
+            std::memcpy(target.pixels, pixels, sizeof(target.pixels));
+            std::memcpy(target.ram, ram, sizeof(target.ram));
+
+            target.sequence.store(sequence + 2, std::memory_order_release);
+            shared->latest.store(index, std::memory_order_release);
+            shared->published.fetch_add(1, std::memory_order_release);
+        };
+
+    private:
+        shared_frame* shared = nullptr;
+        std::string name;
+    };
+
+    // Maps a publisher's object, read only, and
+    // copies frames out of it following the
+    // protocol above.
+    class shared_frame_reader
+    {
+    public:
+        shared_frame_reader() = default;
+        shared_frame_reader(const shared_frame_reader&) = delete;
+        shared_frame_reader& operator=(const shared_frame_reader&) = delete;
+
+        ~shared_frame_reader()
+        {
+            close();
+        };
+
+        bool open(const std::string& object_name)
+        {
+            close();
+
+            int fd = shm_open(object_name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+            {
+                return false;
+            }
+            void* mapping = mmap(nullptr, sizeof(shared_frame), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+            {
+                return false;
+            }
+            shared = static_cast<const shared_frame*>(mapping);
+            if (shared->magic != shared_frame::magic_value || shared->version != shared_frame::version_value)
+            {
+                close();
+                return false;
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        };
+
+        void close()
+        {
+            if (shared)
+            {
+                munmap(const_cast<shared_frame*>(shared), sizeof(shared_frame));
+                shared = nullptr;
+            }
+        };
+
+        bool is_open() const
+        {
+            return shared != nullptr;
+        };
+
+        // How many frames have been published so
+        // far, to tell whether there's a new one.
+        uint64_t published() const
+        {
+            return shared->published.load(std::memory_order_acquire);
+        };
+
+        // Copies out the newest frame. Either buffer
+        // can be null to skip it. Returns false if
+        // nothing has been published yet, or if the
+        // publisher kept lapping us.
+        bool read(uint64_t& frame, byte* pixels, byte* ram) const
+        {
+            for (int attempt = 0; attempt < 16; ++attempt)
+            {
+                if (published() == 0)
+                {
+                    return false;
+                }
+                const shared_frame::slot& source = shared->slots[shared->latest.load(std::memory_order_acquire)];
+                uint64_t before = source.sequence.load(std::memory_order_acquire);
+                if (before & 1)
+                {
+                    continue;
+                }
+                frame = source.frame;
+                if (pixels)
+                {
+                    std::memcpy(pixels, source.pixels, sizeof(source.pixels));
+                }
+                if (ram)
+                {
+                    std::memcpy(ram, source.ram, sizeof(source.ram));
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (source.sequence.load(std::memory_order_relaxed) == before)
+                {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+    private:
+        const shared_frame* shared = nullptr;
+    };
+};
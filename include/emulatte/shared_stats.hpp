@@ -0,0 +1,233 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "fundamentals.hpp"
+#include "system.hpp"
+
+namespace emulatte
+{
+    // A running emulator's performance counters,
+    // in a small POSIX shared memory object named
+    // after its process, so emulatte-top can watch
+    // every instance on the machine at once without
+    // getting in their way. Like shared_frame it's
+    // plain fixed-size data, read in place - don't
+    // reorder it without bumping the version.
+    //
+    // It's updated once a frame under a sequence
+    // number that is odd while the update is in
+    // progress: a reader copies everything out,
+    // and tries again if the number moved or was
+    // odd.
+    struct shared_stats
+    {
+        static constexpr uint32_t magic_value = 0x5354'4C55; // "ULTS"
+        static constexpr uint32_t version_value = 1;
+        // Every object is this followed by the pid.
+        static constexpr const char* name_prefix = "/emulatte-stats-";
+
+        uint32_t magic;
+        uint32_t version;
+        int32_t pid;
+        char region[12];
+        // The ROM's file name, cut short if need be.
+        char rom[64];
+
+        // Keep what changes every frame on its own
+        // cache lines, away from the header.
+        alignas(64) std::atomic<uint64_t> sequence;
+        // When this was last updated, in wall clock
+        // nanoseconds since the epoch, so a reader
+        // can tell a stalled instance from a busy
+        // one.
+        uint64_t updated;
+        perf_counters last_frame;
+        perf_counters totals;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "shared_stats needs lock-free atomics to work across processes");
+
+    // Creates this process's stats object and
+    // keeps it up to date.
+    class shared_stats_publisher
+    {
+    public:
+        shared_stats_publisher() = default;
+        shared_stats_publisher(const shared_stats_publisher&) = delete;
+        shared_stats_publisher& operator=(const shared_stats_publisher&) = delete;
+
+        ~shared_stats_publisher()
+        {
+            close();
+        };
+
+        bool open(const std::string& rom, const std::string& region)
+        {
+            close();
+
+            std::string object_name = shared_stats::name_prefix + std::to_string(getpid());
+            int fd = shm_open(object_name.c_str(), O_CREAT | O_RDWR, 0644);
+            if (fd < 0)
+            {
+                return false;
+            }
+            if (ftruncate(fd, sizeof(shared_stats)) != 0)
+            {
+                ::close(fd);
+                shm_unlink(object_name.c_str());
+                return false;
+            }
+            void* mapping = mmap(nullptr, sizeof(shared_stats), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+            {
+                shm_unlink(object_name.c_str());
+                return false;
+            }
+
+            shared = static_cast<shared_stats*>(mapping);
+            shared->version = shared_stats::version_value;
+            shared->pid = int32_t(getpid());
+            std::strncpy(shared->region, region.c_str(), sizeof(shared->region) - 1);
+            std::strncpy(shared->rom, rom.c_str(), sizeof(shared->rom) - 1);
+            shared->sequence.store(0, std::memory_order_relaxed);
+            // Readers check the magic last, so only
+            // write it once the rest is in place.
+            std::atomic_thread_fence(std::memory_order_release);
+            shared->magic = shared_stats::magic_value;
+            name = object_name;
+            return true;
+        };
+
+        void close()
+        {
+            if (shared)
+            {
+                munmap(shared, sizeof(shared_stats));
+                shm_unlink(name.c_str());
+                shared = nullptr;
+            }
+        };
+
+        bool is_open() const
+        {
+            return shared != nullptr;
+        };
+
+        void publish(const perf_counters& last_frame, const perf_counters& totals)
+        {
+            uint64_t sequence = shared->sequence.load(std::memory_order_relaxed);
+            shared->sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            shared->updated = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+            shared->last_frame = last_frame;
+            shared->totals = totals;
+
+            shared->sequence.store(sequence + 2, std::memory_order_release);
+        };
+
+    private:
+        shared_stats* shared = nullptr;
+        std::string name;
+    };
+
+    // Maps someone else's stats object, read only.
+    class shared_stats_reader
+    {
+    public:
+        // What a read copies out, all of a piece.
+        struct sample
+        {
+            int32_t pid = 0;
+            std::string region;
+            std::string rom;
+            uint64_t updated = 0;
+            perf_counters last_frame;
+            perf_counters totals;
+        };
+
+        shared_stats_reader() = default;
+        shared_stats_reader(const shared_stats_reader&) = delete;
+        shared_stats_reader& operator=(const shared_stats_reader&) = delete;
+
+        ~shared_stats_reader()
+        {
+            close();
+        };
+
+        bool open(const std::string& object_name)
+        {
+            close();
+
+            int fd = shm_open(object_name.c_str(), O_RDONLY, 0);
+            if (fd < 0)
+            {
+                return false;
+            }
+            void* mapping = mmap(nullptr, sizeof(shared_stats), PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (mapping == MAP_FAILED)
+            {
+                return false;
+            }
+            shared = static_cast<const shared_stats*>(mapping);
+            if (shared->magic != shared_stats::magic_value || shared->version != shared_stats::version_value)
+            {
+                close();
+                return false;
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        };
+
+        void close()
+        {
+            if (shared)
+            {
+                munmap(const_cast<shared_stats*>(shared), sizeof(shared_stats));
+                shared = nullptr;
+            }
+        };
+
+        // Gives up after a few tries if the
+        // publisher keeps getting in the way.
+        bool read(sample& out) const
+        {
+            for (int attempt = 0; attempt < 16; ++attempt)
+            {
+                uint64_t before = shared->sequence.load(std::memory_order_acquire);
+                if (before & 1)
+                {
+                    continue;
+                }
+                out.updated = shared->updated;
+                out.last_frame = shared->last_frame;
+                out.totals = shared->totals;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (shared->sequence.load(std::memory_order_relaxed) == before)
+                {
+                    out.pid = shared->pid;
+                    out.region.assign(shared->region, strnlen(shared->region, sizeof(shared->region)));
+                    out.rom.assign(shared->rom, strnlen(shared->rom, sizeof(shared->rom)));
+                    return true;
+                }
+            }
+            return false;
+        };
+
+    private:
+        const shared_stats* shared = nullptr;
+    };
+};
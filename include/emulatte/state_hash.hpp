@@ -0,0 +1,190 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "fundamentals.hpp"
+#include "system.hpp"
+
+namespace emulatte
+{
+    // A fast non-cryptographic hash, for telling
+    // apart states that should be identical. It
+    // keeps four independent lanes going over 32
+    // bytes at a time, so the compiler can keep
+    // them all in flight (or in vector registers)
+    // at once, and folds them together at the end.
+    // The primes and the per-lane round are
+    // borrowed from xxHash64, but the tail and the
+    // final mix aren't the same, so the values it
+    // gives only mean anything to itself.
+    inline uint64_t hash_bytes(const byte* data, size_t size, uint64_t seed = 0)
+    {
+        constexpr uint64_t prime1 = 0x9E37'79B1'85EB'CA87;
+        constexpr uint64_t prime2 = 0xC2B2'AE3D'27D4'EB4F;
+        constexpr uint64_t prime3 = 0x1656'67B1'9E37'79F9;
+
+        auto round = [&](uint64_t lane, uint64_t input)
+        {
+            return std::rotl(lane + input * prime2, 31) * prime1;
+        };
+
+        std::array<uint64_t, 4> lanes = { seed + prime1 + prime2, seed + prime2, seed, seed - prime1 };
+        size_t offset = 0;
+        for (; offset + 32 <= size; offset += 32)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+            {
+                uint64_t input;
+                std::memcpy(&input, data + offset + lane * 8, 8);
+                lanes[lane] = round(lanes[lane], input);
+            }
+        }
+
+        uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) +
+                        std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+        for (uint64_t lane : lanes)
+        {
+            hash = (hash ^ round(0, lane)) * prime1 + prime3;
+        }
+        hash += size;
+
+        // Whatever didn't fill a whole stripe.
+        for (; offset < size; ++offset)
+        {
+            hash = std::rotl(hash ^ (data[offset] * prime3), 11) * prime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= prime2;
+        hash ^= hash >> 29;
+        hash *= prime3;
+        hash ^= hash >> 32;
+        return hash;
+    };
+
+    // Hashes everything that decides what the
+    // system does next: exactly what save() puts
+    // in a snapshot, so CPU and bus registers,
+    // RAM and PRG-RAM, the PPU and APU, and the
+    // events still to come. Snapshots have no
+    // padding, so the bytes are the state and
+    // nothing else. Two runs that agree on this
+    // every frame are doing the same thing.
+    template <typename Region>
+    uint64_t hash_state(const basic_system<Region>& nes)
+    {
+        typename basic_system<Region>::snapshot state;
+        nes.save(state);
+        return hash_bytes(reinterpret_cast<const byte*>(&state), sizeof(state));
+    };
+
+    // A log of one hash per frame. It's a short
+    // header followed by fixed 16-byte records of
+    // frame number and hash, so two logs can be
+    // compared by streaming through them side by
+    // side, however long the runs were.
+    struct state_hash_record
+    {
+        uint64_t frame;
+        uint64_t hash;
+    };
+
+    struct state_hash_header
+    {
+        static constexpr uint32_t magic_value = 0x4854'4C55; // "ULTH"
+        static constexpr uint32_t version_value = 1;
+
+        uint32_t magic = magic_value;
+        uint32_t version = version_value;
+    };
+
+    class state_hash_writer
+    {
+    public:
+        state_hash_writer() = default;
+        state_hash_writer(const state_hash_writer&) = delete;
+        state_hash_writer& operator=(const state_hash_writer&) = delete;
+
+        ~state_hash_writer()
+        {
+            close();
+        };
+
+        bool open(const std::string& path)
+        {
+            close();
+            file = std::fopen(path.c_str(), "wb");
+            if (!file)
+            {
+                return false;
+            }
+            // Records are tiny, so let stdio gather a
+            // good few of them into each write.
+            std::setvbuf(file, nullptr, _IOFBF, 1 << 16);
+            state_hash_header header;
+            return std::fwrite(&header, sizeof(header), 1, file) == 1;
+        };
+
+        void close()
+        {
+            if (file)
+            {
+                std::fclose(file);
+                file = nullptr;
+            }
+        };
+
+        bool is_open() const
+        {
+            return file != nullptr;
+        };
+
+        void write(uint64_t frame, uint64_t hash)
+        {
+            state_hash_record record = { frame, hash };
+            std::fwrite(&record, sizeof(record), 1, file);
+        };
+
+    private:
+        std::FILE* file = nullptr;
+    };
+
+    class state_hash_reader
+    {
+    public:
+        state_hash_reader() = default;
+        state_hash_reader(const state_hash_reader&) = delete;
+        state_hash_reader& operator=(const state_hash_reader&) = delete;
+
+        ~state_hash_reader()
+        {
+            if (file)
+            {
+                std::fclose(file);
+            }
+        };
+
+        // Opens a log and checks it is one.
+        bool open(const std::string& path)
+        {
+            file = std::fopen(path.c_str(), "rb");
+            state_hash_header header;
+            return file && std::fread(&header, sizeof(header), 1, file) == 1 &&
+                   header.magic == state_hash_header::magic_value &&
+                   header.version == state_hash_header::version_value;
+        };
+
+        bool next(state_hash_record& record)
+        {
+            return std::fread(&record, sizeof(record), 1, file) == 1;
+        };
+
+    private:
+        std::FILE* file = nullptr;
+    };
+};
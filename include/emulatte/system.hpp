@@ -0,0 +1,561 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <type_traits>
+
+#include "apu.hpp"
+#include "battery.hpp"
+#include "cartridge.hpp"
+#include "cpu.hpp"
+#include "fundamentals.hpp"
+#include "ppu.hpp"
+#include "region.hpp"
+#include "scheduler.hpp"
+
+namespace emulatte
+{
+    // Running totals of where the work went, for
+    // keeping an eye on a system while it runs.
+    // They're all plain counters, bumped where
+    // the work happens anyway, so they're always
+    // on. Time is wall time, split between
+    // running the CPU and handling events - which
+    // is where all the PPU and APU work happens.
+    struct perf_counters
+    {
+        uint64_t frames = 0;
+        uint64_t instructions = 0;
+        uint64_t cycles = 0;
+        uint64_t idle_cycles_skipped = 0;
+        // Cycles the CPU spent halted for OAM DMA,
+        // the only DMA we have. The DMC's sample
+        // fetches steal cycles too, on hardware;
+        // once the DMC is emulated, its fetches
+        // belong here as well, counted wherever
+        // they're scheduled, the way oam_dma() does.
+        uint64_t dma_stall_cycles = 0;
+        uint64_t events = 0;
+        uint64_t cpu_nanoseconds = 0;
+        uint64_t event_nanoseconds = 0;
+
+        perf_counters operator-(const perf_counters& since) const
+        {
+            return { frames - since.frames,
+                     instructions - since.instructions,
+                     cycles - since.cycles,
+                     idle_cycles_skipped - since.idle_cycles_skipped,
+                     dma_stall_cycles - since.dma_stall_cycles,
+                     events - since.events,
+                     cpu_nanoseconds - since.cpu_nanoseconds,
+                     event_nanoseconds - since.event_nanoseconds };
+        };
+    };
+
+    // The whole console: the CPU and the chips on
+    // its bus, the cartridge plugged into it, and
+    // whatever it has drawn. The region decides
+    // all the timing, at compile time, so each
+    // kind of console gets its own copy of the
+    // code with its numbers built in.
+    template <typename Region>
+    struct basic_system
+    {
+        using region = Region;
+        using cpu = basic_cpu<Region>;
+        using scheduler = basic_scheduler<Region>;
+
+        // The visible picture is 256x240, and each
+        // pixel is a palette index (0-63) rather than
+        // a colour, the same thing the real PPU puts
+        // out. Turning it into RGB is left to whoever
+        // is looking at it.
+        static constexpr int screen_width = 256;
+        static constexpr int screen_height = 240;
+        // Frame timing, in master clock ticks. Vblank
+        // starts on the second dot of its line, and
+        // ends on the second dot of the pre-render
+        // line, the last of the frame.
+        static constexpr uint64_t frame_length =
+            ppu::dots_per_scanline * Region::scanlines_per_frame * scheduler::ppu_divider;
+        static constexpr uint64_t vblank_start =
+            (Region::vblank_scanline * ppu::dots_per_scanline + 1) * scheduler::ppu_divider;
+        static constexpr uint64_t vblank_end =
+            ((Region::scanlines_per_frame - 1) * ppu::dots_per_scanline + 1) * scheduler::ppu_divider;
+
+        // Everything needed to put the system back
+        // exactly where it was. It's a fixed size and
+        // holds no pointers, so saving and restoring
+        // are plain copies that never allocate, and
+        // it can be handed around as raw bytes.
+        //
+        // It also has no padding - the members are
+        // in an order that leaves no gaps - so every
+        // byte of it is part of the state, and two
+        // snapshots of the same state are the same
+        // bytes. That's what hash_state hashes.
+        struct snapshot
+        {
+            uint64_t cycles = 0;
+            uint64_t frame = 0;
+            scheduler_events::queue events;
+            word PC = 0;
+            byte A = 0;
+            byte X = 0;
+            byte Y = 0;
+            byte S = 0;
+            byte P = 0;
+            bool jammed = false;
+            byte open_bus = 0;
+            std::array<byte, 2> controllers = {};
+            std::array<byte, 2> controller_shift = {};
+            bool controller_strobe = false;
+            byte irq_sources = 0;
+            apu audio;
+            std::array<byte, 0x800> ram = {};
+            std::array<byte, 0x2000> prg_ram = {};
+            ppu_state video;
+            std::array<byte, 0x800> nametables = {};
+            std::array<byte, 0x2000> patterns = {};
+        };
+
+        cpu processor;
+        ppu video;
+        apu audio;
+        scheduler events;
+        // The ROM we're running, if one has been
+        // loaded. It never changes once it's loaded,
+        // so copies of the system share it.
+        std::shared_ptr<const cartridge> cart;
+        // The save file behind $6000-$7FFF, if the
+        // cart has one and it's been loaded. Copies
+        // of the system don't get it.
+        std::shared_ptr<battery_ram> battery;
+        // Where PRG-RAM goes while the save file is
+        // detached. It's made along with the save
+        // file, so detaching never allocates.
+        std::shared_ptr<std::array<byte, battery_ram::size>> detached_prg_ram;
+        bool battery_detached = false;
+        std::array<byte, screen_width * screen_height> framebuffer = {};
+        uint64_t frame = 0;
+        // What went into the last whole frame. The
+        // running totals are counters(), some of
+        // which are kept here and the rest by the
+        // CPU. None of it is part of the emulated
+        // state, so snapshots leave it alone.
+        perf_counters last_frame_counters;
+        perf_counters frame_start_counters;
+        uint64_t dma_stall_cycles = 0;
+        uint64_t events_handled = 0;
+        uint64_t cpu_nanoseconds = 0;
+        uint64_t event_nanoseconds = 0;
+
+        basic_system()
+        {
+            connect();
+            // The PPU starts its first frame as the
+            // power comes on, so its timeline is
+            // already running.
+            events.schedule(scheduler::event::FrameEnd, frame_length);
+            events.schedule(scheduler::event::VblankStart, vblank_start);
+            events.schedule(scheduler::event::VblankEnd, vblank_end);
+            // So does the APU's frame counter, in 4-step
+            // mode with its IRQ enabled, as if $4017 had
+            // just been written with 0.
+            events.schedule(scheduler::event::FrameIrq, Region::frame_irq_first * scheduler::cpu_divider);
+        };
+
+        // The chips point at each other, so a copy
+        // has to be rewired to its own ones.
+        basic_system(const basic_system& other) :
+            basic_system{ other, fork_t{} }
+        {
+            framebuffer = other.framebuffer;
+        };
+
+        // A copy of everything but the framebuffer,
+        // which starts out blank. See fork().
+        struct fork_t {};
+        basic_system(const basic_system& other, fork_t) :
+            processor{ other.processor },
+            video{ other.video },
+            audio{ other.audio },
+            events{ other.events },
+            cart{ other.cart },
+            frame{ other.frame }
+        {
+            connect();
+            frame_start_counters = counters();
+        };
+
+        // A copy of this system to branch off from,
+        // which costs about as much as a save().
+        // Memory outside the 2KB of RAM - PRG-RAM,
+        // nametables and CHR - is shared page by
+        // page, and each side only copies the pages
+        // it goes on to write; the ROM is shared
+        // outright. The framebuffer isn't copied at
+        // all: it's the picture of a frame that's
+        // already over, and the fork draws its own
+        // from its first frame on.
+        //
+        // Nothing is written to this system, but
+        // it's read all the way through, so a fork
+        // can't be taken while it runs on another
+        // thread.
+        std::unique_ptr<basic_system> fork() const
+        {
+            return std::make_unique<basic_system>(*this, fork_t{});
+        };
+
+        basic_system& operator=(const basic_system& other)
+        {
+            processor = other.processor;
+            video = other.video;
+            audio = other.audio;
+            events = other.events;
+            cart = other.cart;
+            framebuffer = other.framebuffer;
+            frame = other.frame;
+            // The copy left us with private PRG-RAM;
+            // if we have a save file, take what the
+            // other system had there and keep going
+            // in the file.
+            attach_battery();
+            connect();
+            frame_start_counters = counters();
+            return *this;
+        };
+
+        // Loads an iNES file and maps it into CPU
+        // memory. Only NROM (mapper 0) for now, which
+        // has no banking, so anything with more PRG
+        // than fits in $8000-$FFFF needs a mapper we
+        // don't have and is turned away.
+        bool load_rom(const std::filesystem::path& path)
+        {
+            auto loaded = std::make_shared<cartridge>();
+            if (!loaded->load(path) || loaded->mapper != 0 || loaded->prg.size() < 0x100 || loaded->prg.size() > 0x8000)
+            {
+                return false;
+            }
+            cart = std::move(loaded);
+
+            // NROM-128 has a single 16KB bank that
+            // shows up at both $8000 and $C000, so
+            // those pages are shared.
+            auto& memory = processor.memory;
+            auto& table = memory.own_pages();
+            size_t prg_pages = std::min<size_t>(cart->prg.size() / 0x100, 0x80);
+            for (size_t page = 0; page < 0x80; ++page)
+            {
+                auto& block = table[0x80 + page];
+                if (page < prg_pages)
+                {
+                    block = std::make_shared<memory_page>();
+                    std::copy_n(cart->prg.begin() + page * 0x100, 0x100, block->begin());
+                }
+                else
+                {
+                    block = table[0x80 + page % prg_pages];
+                }
+            }
+            memory.map_pages();
+            // Carts without CHR ROM have 8KB of RAM
+            // there instead, which starts out empty.
+            for (size_t page = 0; page < video.patterns.size(); ++page)
+            {
+                auto& block = video.patterns[page];
+                if (page * 0x100 < cart->chr.size())
+                {
+                    block = std::make_shared<memory_page>();
+                    std::copy_n(cart->chr.begin() + page * 0x100, std::min<size_t>(cart->chr.size() - page * 0x100, 0x100), block->begin());
+                }
+                else
+                {
+                    block = blank_page();
+                }
+            }
+            video.vertical_mirroring = cart->vertical_mirroring;
+            ++processor.memory.side_effects;
+            return true;
+        };
+
+        // Puts the save file behind $6000-$7FFF, so
+        // whatever the game writes there is kept.
+        // Moves PRG-RAM off the save file and onto
+        // a private copy of it, so that nothing
+        // written from here on reaches the file -
+        // for running frames that are going to be
+        // thrown away. The file is mapped shared, so
+        // without this the kernel (or our own
+        // flusher) could write them out at any time.
+        void detach_battery()
+        {
+            if (battery && !battery_detached)
+            {
+                std::copy_n(battery->data(), battery_ram::size, detached_prg_ram->data());
+                processor.memory.pin_pages(0x60, 0x20, detached_prg_ram, detached_prg_ram->data());
+                battery_detached = true;
+            }
+        };
+
+        // Puts PRG-RAM back in the save file, taking
+        // whatever it holds now along with it. Only
+        // pages that changed are written, so the
+        // file isn't dirtied (and written back to
+        // disk) for nothing - and after run-ahead
+        // has put the state back, none have.
+        void attach_battery()
+        {
+            if (battery)
+            {
+                for (int page = 0; page < 0x20; ++page)
+                {
+                    const auto& held = processor.memory.page_at(0x60 + page);
+                    byte* saved = battery->data() + page * 0x100;
+                    if (!std::equal(held.begin(), held.end(), saved))
+                    {
+                        std::copy_n(held.begin(), 0x100, saved);
+                    }
+                }
+                processor.memory.pin_pages(0x60, 0x20, battery, battery->data());
+                battery_detached = false;
+            }
+        };
+
+        bool load_battery(const std::filesystem::path& path)
+        {
+            auto save = std::make_shared<battery_ram>();
+            if (!save->open(path))
+            {
+                return false;
+            }
+            battery = save;
+            detached_prg_ram = std::make_shared<std::array<byte, battery_ram::size>>();
+            battery_detached = false;
+            processor.memory.pin_pages(0x60, 0x20, save, save->data());
+            ++processor.memory.side_effects;
+            return true;
+        };
+
+        void reset()
+        {
+            processor.reset();
+        };
+
+        // Runs until the PPU finishes the current
+        // frame. The CPU goes in batches, each one
+        // up to whenever the next event is due,
+        // and in between we handle everything that
+        // has come due and take any interrupts.
+        // Instructions don't stop on event times,
+        // so an event can be handled a few cycles
+        // late, but never early, and everything
+        // scheduled from it is still relative to
+        // when it was due.
+        //
+        // A debugger can ask for control back part
+        // way through, in which case we return early
+        // and the next call carries on with the same
+        // frame.
+        void run_frame();
+
+        // Runs exactly one instruction, and then
+        // whatever came due during it.
+        void step_instruction();
+
+        // Handles everything that has come due, and
+        // then takes an IRQ if one is waiting.
+        void service_events();
+
+        void dispatch(scheduler_events::event type, uint64_t time);
+
+        // Sets the buttons held on a controller
+        // port, in the order the pad shifts them
+        // out: bit 0 is A, then B, Select, Start,
+        // Up, Down, Left and Right.
+        void set_input(int port, byte buttons)
+        {
+            processor.memory.controllers[port & 1] = buttons;
+        };
+
+        void save(snapshot& out) const
+        {
+            const auto& memory = processor.memory;
+            out.cycles = processor.cycles;
+            out.frame = frame;
+            out.PC = processor.PC.value;
+            out.A = processor.A;
+            out.X = processor.X;
+            out.Y = processor.Y;
+            out.S = processor.S;
+            out.P = processor.P.value;
+            out.jammed = processor.jammed;
+            out.open_bus = memory.open_bus;
+            out.controllers = memory.controllers;
+            out.controller_shift = memory.controller_shift;
+            out.controller_strobe = memory.controller_strobe;
+            out.irq_sources = memory.irq_sources;
+            out.video = static_cast<const ppu_state&>(video);
+            out.audio = audio;
+            out.events = events.pending;
+            out.ram = memory.ram;
+            for (int page = 0; page < 0x20; ++page)
+            {
+                std::copy_n(memory.page_at(0x60 + page).begin(), 0x100, out.prg_ram.begin() + page * 0x100);
+            }
+            for (size_t page = 0; page < video.nametables.size(); ++page)
+            {
+                std::copy_n(video.nametables[page]->begin(), 0x100, out.nametables.begin() + page * 0x100);
+            }
+            for (size_t page = 0; page < video.patterns.size(); ++page)
+            {
+                std::copy_n(video.patterns[page]->begin(), 0x100, out.patterns.begin() + page * 0x100);
+            }
+        };
+
+        // Whether a snapshot that came from outside
+        // is safe to restore. restore() trusts what
+        // it's given: the scheduler indexes straight
+        // from the queue in it, and run_frame() runs
+        // until the frame ends. So the queue has to
+        // hold together, the end of the frame has to
+        // be coming, and nothing can be due more than
+        // a couple of frames from now.
+        static bool is_valid(const snapshot& in)
+        {
+            const auto& queue = in.events;
+            if (!queue.is_valid() || queue.position[int(scheduler::event::FrameEnd)] < 0 ||
+                in.cycles > (scheduler::never - 2 * frame_length) / scheduler::cpu_divider)
+            {
+                return false;
+            }
+            uint64_t latest = in.cycles * scheduler::cpu_divider + 2 * frame_length;
+            for (int index = 0; index < queue.size; ++index)
+            {
+                if (queue.heap[index].time > latest)
+                {
+                    return false;
+                }
+            }
+            return true;
+        };
+
+        void restore(const snapshot& in)
+        {
+            auto& memory = processor.memory;
+            processor.cycles = in.cycles;
+            frame = in.frame;
+            processor.PC = in.PC;
+            processor.A = in.A;
+            processor.X = in.X;
+            processor.Y = in.Y;
+            processor.S = in.S;
+            processor.P.value = in.P;
+            processor.jammed = in.jammed;
+            memory.open_bus = in.open_bus;
+            memory.controllers = in.controllers;
+            memory.controller_shift = in.controller_shift;
+            memory.controller_strobe = in.controller_strobe;
+            memory.irq_sources = in.irq_sources;
+            static_cast<ppu_state&>(video) = in.video;
+            audio = in.audio;
+            events.pending = in.events;
+            memory.ram = in.ram;
+            // Pages that already hold the right bytes
+            // are left alone, so they stay shared with
+            // whoever else has them.
+            for (int page = 0; page < 0x20; ++page)
+            {
+                auto source = in.prg_ram.begin() + page * 0x100;
+                if (!std::equal(source, source + 0x100, memory.page_at(0x60 + page).begin()))
+                {
+                    std::copy_n(source, 0x100, memory.own_page(0x60 + page));
+                }
+            }
+            for (size_t page = 0; page < video.nametables.size(); ++page)
+            {
+                auto source = in.nametables.begin() + page * 0x100;
+                if (!std::equal(source, source + 0x100, video.nametables[page]->begin()))
+                {
+                    std::copy_n(source, 0x100, own_page(video.nametables[page]));
+                }
+            }
+            for (size_t page = 0; page < video.patterns.size(); ++page)
+            {
+                auto source = in.patterns.begin() + page * 0x100;
+                if (!std::equal(source, source + 0x100, video.patterns[page]->begin()))
+                {
+                    std::copy_n(source, 0x100, own_page(video.patterns[page]));
+                }
+            }
+            // Memory just changed behind the CPU's
+            // back, so whatever idle loop it was in
+            // can't be trusted anymore.
+            ++memory.side_effects;
+            // The clock may have gone backwards, so
+            // the frame we're in starts counting again
+            // from here.
+            frame_start_counters = counters();
+        };
+
+        // Copies a whole page into OAM in one go.
+        // The real thing alternates 256 reads and
+        // writes, but the source is almost always
+        // plain RAM, so we look up the page once and
+        // copy the span straight across. Writes go in
+        // at OAMADDR and wrap, exactly like $2004
+        // writes would. The CPU is halted for 513
+        // cycles, plus one more to line up if the
+        // DMA started on an odd one.
+        void oam_dma();
+
+        // Plugs the chips into the CPU's bus, and
+        // the scheduler into the CPU's clock.
+        void connect()
+        {
+            processor.memory.video = &video;
+            processor.memory.audio = &audio;
+            processor.memory.events = &events;
+            events.attach(processor.cycles, processor.run_limit);
+        };
+
+        perf_counters counters() const
+        {
+            return { frame,
+                     processor.instructions,
+                     processor.cycles,
+                     processor.idle_cycles_skipped,
+                     dma_stall_cycles,
+                     events_handled,
+                     cpu_nanoseconds,
+                     event_nanoseconds };
+        };
+
+        // The 2KB of internal RAM, without any of
+        // the mirrors.
+        const byte* ram() const
+        {
+            return processor.memory.ram.data();
+        };
+    };
+
+    // The main loop and the event handling are in
+    // system.cpp, compiled there for each region.
+    extern template struct basic_system<ntsc>;
+    extern template struct basic_system<pal>;
+    extern template struct basic_system<dendy>;
+
+    using system = basic_system<ntsc>;
+    using pal_system = basic_system<pal>;
+    using dendy_system = basic_system<dendy>;
+
+    static_assert(std::is_trivially_copyable_v<system::snapshot>,
+                  "snapshots are copied around as raw bytes");
+    static_assert(std::has_unique_object_representations_v<system::snapshot>,
+                  "snapshots are hashed as raw bytes, so they can't have padding");
+};
@@ -0,0 +1,160 @@
+"""Thin Python binding over the emulatte C API (emulatte.h).
+
+The shared library is found through the EMULATTE_LIBRARY environment
+variable, or next to this file. Everything that moves data takes NumPy
+arrays you allocate once up front; a step writes straight into them, so
+the per-step cost is a single foreign call.
+
+    nes = Emulator("game.nes")
+    inputs = np.zeros((60, 2), np.uint8)
+    pixels = np.empty((60, 240, 256), np.uint8)
+    nes.step(60, inputs=inputs, pixels=pixels)
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+SCREEN_WIDTH = 256
+SCREEN_HEIGHT = 240
+RAM_SIZE = 0x800
+
+REGIONS = {"ntsc": 0, "pal": 1, "dendy": 2}
+
+BUTTON_A = 0x01
+BUTTON_B = 0x02
+BUTTON_SELECT = 0x04
+BUTTON_START = 0x08
+BUTTON_UP = 0x10
+BUTTON_DOWN = 0x20
+BUTTON_LEFT = 0x40
+BUTTON_RIGHT = 0x80
+
+_API_VERSION = 1
+_ERROR_SNAPSHOT = -3
+
+
+def _load_library():
+    path = os.environ.get("EMULATTE_LIBRARY")
+    if path is None:
+        here = os.path.dirname(os.path.abspath(__file__))
+        for name in ("libemulatte_c.so", "libemulatte_c.dylib", "emulatte_c.dll"):
+            candidate = os.path.join(here, name)
+            if os.path.exists(candidate):
+                path = candidate
+                break
+    if path is None:
+        raise OSError("couldn't find the emulatte_c library; set EMULATTE_LIBRARY")
+
+    lib = ctypes.CDLL(path)
+    handle = ctypes.c_void_p
+    buffer = ctypes.c_void_p
+
+    lib.emulatte_api_version.restype = ctypes.c_int
+    lib.emulatte_create.restype = handle
+    lib.emulatte_create_region.argtypes = [ctypes.c_int]
+    lib.emulatte_create_region.restype = handle
+    lib.emulatte_destroy.argtypes = [handle]
+    lib.emulatte_load_rom.argtypes = [handle, ctypes.c_char_p]
+    lib.emulatte_load_rom.restype = ctypes.c_int
+    lib.emulatte_reset.argtypes = [handle]
+    lib.emulatte_set_input.argtypes = [handle, ctypes.c_int, ctypes.c_uint8]
+    lib.emulatte_step.argtypes = [handle, ctypes.c_uint32, buffer, buffer, buffer]
+    lib.emulatte_step.restype = ctypes.c_uint64
+    lib.emulatte_framebuffer.argtypes = [handle]
+    lib.emulatte_framebuffer.restype = ctypes.POINTER(ctypes.c_uint8)
+    lib.emulatte_ram.argtypes = [handle]
+    lib.emulatte_ram.restype = ctypes.POINTER(ctypes.c_uint8)
+    lib.emulatte_snapshot_size.restype = ctypes.c_size_t
+    lib.emulatte_snapshot.argtypes = [handle, buffer, ctypes.c_size_t]
+    lib.emulatte_snapshot.restype = ctypes.c_int
+    lib.emulatte_restore.argtypes = [handle, buffer, ctypes.c_size_t]
+    lib.emulatte_restore.restype = ctypes.c_int
+
+    if lib.emulatte_api_version() != _API_VERSION:
+        raise OSError("emulatte_c library is API version %d, expected %d"
+                      % (lib.emulatte_api_version(), _API_VERSION))
+    return lib
+
+
+_lib = _load_library()
+
+
+def _pointer(array, shape, name):
+    """Checks a caller buffer and returns its address, or None."""
+    if array is None:
+        return None
+    if array.dtype != np.uint8 or not array.flags.c_contiguous:
+        raise ValueError("%s must be a C-contiguous uint8 array" % name)
+    if array.size < int(np.prod(shape)):
+        raise ValueError("%s needs room for %s, got %s" % (name, shape, array.shape))
+    return array.ctypes.data
+
+
+class Emulator:
+    def __init__(self, rom=None, region="ntsc"):
+        if region not in REGIONS:
+            raise ValueError("region must be one of %s" % ", ".join(REGIONS))
+        self._handle = _lib.emulatte_create_region(REGIONS[region])
+        if not self._handle:
+            raise MemoryError("couldn't create an emulatte system")
+        # Zero-copy views of the live system.
+        self.framebuffer = np.ctypeslib.as_array(
+            _lib.emulatte_framebuffer(self._handle), (SCREEN_HEIGHT, SCREEN_WIDTH))
+        self.ram = np.ctypeslib.as_array(_lib.emulatte_ram(self._handle), (RAM_SIZE,))
+        if rom is not None:
+            self.load_rom(rom)
+
+    def __del__(self):
+        if getattr(self, "_handle", None):
+            _lib.emulatte_destroy(self._handle)
+            self._handle = None
+
+    def load_rom(self, path):
+        if _lib.emulatte_load_rom(self._handle, os.fsencode(path)) != 0:
+            raise ValueError("couldn't load %s (only iNES mapper 0 is supported)" % path)
+        self.reset()
+
+    def reset(self):
+        _lib.emulatte_reset(self._handle)
+
+    def set_input(self, port, buttons):
+        _lib.emulatte_set_input(self._handle, port, buttons)
+
+    def step(self, frames=1, inputs=None, pixels=None, ram=None):
+        """Runs `frames` frames; returns the total frame count.
+
+        inputs: (frames, 2) uint8 buttons per port, applied before each frame.
+        pixels: (frames, 240, 256) uint8, filled with each frame.
+        ram:    (frames, 2048) uint8, filled with RAM after each frame.
+        """
+        return _lib.emulatte_step(
+            self._handle, frames,
+            _pointer(inputs, (frames, 2), "inputs"),
+            _pointer(pixels, (frames, SCREEN_HEIGHT, SCREEN_WIDTH), "pixels"),
+            _pointer(ram, (frames, RAM_SIZE), "ram"))
+
+    @staticmethod
+    def snapshot_buffer():
+        """Allocates a buffer that can hold one save state."""
+        return np.empty(_lib.emulatte_snapshot_size(), np.uint8)
+
+    def snapshot(self, buffer):
+        """Saves the state into a buffer from snapshot_buffer()."""
+        if buffer is None:
+            raise ValueError("snapshot needs a buffer; allocate one with snapshot_buffer()")
+        size = _lib.emulatte_snapshot_size()
+        if _lib.emulatte_snapshot(self._handle, _pointer(buffer, (size,), "buffer"), buffer.size) != 0:
+            raise ValueError("snapshot buffer is too small")
+
+    def restore(self, buffer):
+        """Restores a state saved by snapshot() on a system of the same region."""
+        if buffer is None:
+            raise ValueError("restore needs a buffer filled by snapshot()")
+        size = _lib.emulatte_snapshot_size()
+        result = _lib.emulatte_restore(self._handle, _pointer(buffer, (size,), "buffer"), buffer.size)
+        if result == _ERROR_SNAPSHOT:
+            raise ValueError("snapshot is damaged, or from another region or library version")
+        if result != 0:
+            raise ValueError("snapshot buffer is too small")
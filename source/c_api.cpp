@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <variant>
+
+#include "emulatte.h"
+#include "system.hpp"
+
+// The handle we give out is just the system
+// itself - the C side never sees inside it.
+// Each region is its own type, so we hold
+// whichever one was asked for, and every call
+// picks the right code once on the way in.
+struct emulatte_system
+{
+    std::variant<emulatte::system, emulatte::pal_system, emulatte::dendy_system> nes;
+};
+
+// Snapshots are laid out the same whatever the
+// region, so one size fits them all.
+using snapshot = emulatte::system::snapshot;
+static_assert(sizeof(snapshot) == sizeof(emulatte::pal_system::snapshot) &&
+              sizeof(snapshot) == sizeof(emulatte::dendy_system::snapshot));
+
+// What goes in front of every snapshot we hand
+// out. The layout of the state is the same for
+// every region, so without this a PAL state
+// would restore into an NTSC system without
+// complaint and quietly run with the wrong
+// clocks - and one from another build of the
+// library would be read as garbage.
+struct snapshot_header
+{
+    static constexpr uint32_t magic_value = 0x5353'4C55; // "ULSS"
+
+    uint32_t magic;
+    uint32_t api_version;
+    uint32_t region;
+    uint32_t size;
+};
+
+static constexpr size_t snapshot_bytes = sizeof(snapshot_header) + sizeof(snapshot);
+
+int emulatte_api_version(void)
+{
+    return EMULATTE_API_VERSION;
+};
+
+emulatte_system* emulatte_create(void)
+{
+    return emulatte_create_region(EMULATTE_REGION_NTSC);
+};
+
+emulatte_system* emulatte_create_region(int region)
+{
+    switch (region)
+    {
+    case EMULATTE_REGION_NTSC:
+        return new (std::nothrow) emulatte_system{ decltype(emulatte_system::nes){ std::in_place_index<0> } };
+    case EMULATTE_REGION_PAL:
+        return new (std::nothrow) emulatte_system{ decltype(emulatte_system::nes){ std::in_place_index<1> } };
+    case EMULATTE_REGION_DENDY:
+        return new (std::nothrow) emulatte_system{ decltype(emulatte_system::nes){ std::in_place_index<2> } };
+    default:
+        return nullptr;
+    }
+};
+
+void emulatte_destroy(emulatte_system* system)
+{
+    delete system;
+};
+
+int emulatte_region(const emulatte_system* system)
+{
+    if (!system)
+    {
+        return EMULATTE_ERROR_ARGUMENT;
+    }
+    return int(system->nes.index());
+};
+
+int emulatte_load_rom(emulatte_system* system, const char* path)
+{
+    if (!system || !path)
+    {
+        return EMULATTE_ERROR_ARGUMENT;
+    }
+    return std::visit([&](auto& nes) { return nes.load_rom(path); }, system->nes) ? EMULATTE_OK
+                                                                                   : EMULATTE_ERROR_ROM;
+};
+
+void emulatte_reset(emulatte_system* system)
+{
+    if (!system)
+    {
+        return;
+    }
+    std::visit([](auto& nes) { nes.reset(); }, system->nes);
+};
+
+void emulatte_set_input(emulatte_system* system, int port, uint8_t buttons)
+{
+    if (!system)
+    {
+        return;
+    }
+    std::visit([&](auto& nes) { nes.set_input(port, buttons); }, system->nes);
+};
+
+uint64_t emulatte_step(emulatte_system* system, uint32_t frames,
+                       const uint8_t* inputs, uint8_t* pixels, uint8_t* ram)
+{
+    if (!system)
+    {
+        return 0;
+    }
+    return std::visit([&](auto& nes)
+    {
+        for (uint32_t i = 0; i < frames; ++i)
+        {
+            if (inputs)
+            {
+                nes.set_input(0, inputs[i * 2]);
+                nes.set_input(1, inputs[i * 2 + 1]);
+            }
+            nes.run_frame();
+            if (pixels)
+            {
+                std::copy(nes.framebuffer.begin(), nes.framebuffer.end(), pixels + size_t(i) * EMULATTE_FRAMEBUFFER_SIZE);
+            }
+            if (ram)
+            {
+                std::copy_n(nes.ram(), EMULATTE_RAM_SIZE, ram + size_t(i) * EMULATTE_RAM_SIZE);
+            }
+        }
+        return nes.frame;
+    }, system->nes);
+};
+
+const uint8_t* emulatte_framebuffer(const emulatte_system* system)
+{
+    if (!system)
+    {
+        return nullptr;
+    }
+    return std::visit([](const auto& nes) { return nes.framebuffer.data(); }, system->nes);
+};
+
+const uint8_t* emulatte_ram(const emulatte_system* system)
+{
+    if (!system)
+    {
+        return nullptr;
+    }
+    return std::visit([](const auto& nes) { return nes.ram(); }, system->nes);
+};
+
+size_t emulatte_snapshot_size(void)
+{
+    return snapshot_bytes;
+};
+
+// Snapshots are trivially copyable, so going
+// through a byte buffer is a memcpy each way.
+// That also means the caller's buffer doesn't
+// need to be aligned for the struct.
+int emulatte_snapshot(const emulatte_system* system, void* buffer, size_t size)
+{
+    if (!system || !buffer || size < snapshot_bytes)
+    {
+        return EMULATTE_ERROR_ARGUMENT;
+    }
+    snapshot_header header{ snapshot_header::magic_value, EMULATTE_API_VERSION,
+                            uint32_t(system->nes.index()), uint32_t(sizeof(snapshot)) };
+    std::memcpy(buffer, &header, sizeof(header));
+    std::visit([&](const auto& nes)
+    {
+        typename std::remove_cvref_t<decltype(nes)>::snapshot state;
+        nes.save(state);
+        std::memcpy(static_cast<std::byte*>(buffer) + sizeof(header), &state, sizeof(state));
+    }, system->nes);
+    return EMULATTE_OK;
+};
+
+int emulatte_restore(emulatte_system* system, const void* buffer, size_t size)
+{
+    if (!system || !buffer || size < snapshot_bytes)
+    {
+        return EMULATTE_ERROR_ARGUMENT;
+    }
+    snapshot_header header;
+    std::memcpy(&header, buffer, sizeof(header));
+    if (header.magic != snapshot_header::magic_value || header.api_version != EMULATTE_API_VERSION ||
+        header.region != system->nes.index() || header.size != sizeof(snapshot))
+    {
+        return EMULATTE_ERROR_SNAPSHOT;
+    }
+    buffer = static_cast<const std::byte*>(buffer) + sizeof(header);
+    return std::visit([&](auto& nes)
+    {
+        typename std::remove_cvref_t<decltype(nes)>::snapshot state;
+        std::memcpy(&state, buffer, sizeof(state));
+        // The header only says where the state
+        // came from; whether it's usable is a
+        // question for the system.
+        if (!nes.is_valid(state))
+        {
+            return EMULATTE_ERROR_SNAPSHOT;
+        }
+        nes.restore(state);
+        return EMULATTE_OK;
+    }, system->nes);
+};
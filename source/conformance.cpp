@@ -0,0 +1,556 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "spdlog/spdlog.h"
+
+#include "cpu.hpp"
+#include "fundamentals.hpp"
+
+// Runs the per-opcode single-step CPU tests, the
+// JSON ones with about 10,000 cases per opcode
+// (the nes6502 set, as the 2A03 has no decimal
+// mode). Usage:
+//
+//     emulatte-conformance <dir or .json files...> [--jobs N] [--verbose]
+//
+// Each case gives the registers and the RAM the
+// instruction touches, before and after, and the
+// bus activity of every cycle. We check the
+// final registers and RAM, and that the number
+// of cycles matches; the interpreter works an
+// instruction at a time, so there's no bus
+// activity to compare beyond that.
+//
+// The files add up to gigabytes, so they are
+// never loaded whole. Each one is parsed one
+// case at a time from a small buffer, and the
+// files are shared out between threads.
+namespace
+{
+    using emulatte::byte;
+    using emulatte::word;
+
+    struct cpu_state
+    {
+        word pc = 0;
+        byte s = 0;
+        byte a = 0;
+        byte x = 0;
+        byte y = 0;
+        byte p = 0;
+        std::vector<std::pair<word, byte>> ram;
+    };
+
+    struct test_case
+    {
+        std::string name;
+        cpu_state initial;
+        cpu_state final;
+        size_t cycles = 0;
+    };
+
+    // Just enough JSON to read the test files: a
+    // pull parser over a buffered file, which
+    // skips anything it doesn't know about.
+    class reader
+    {
+    public:
+        explicit reader(const std::filesystem::path& path) :
+            file{ std::fopen(path.string().c_str(), "rb") }
+        {};
+
+        ~reader()
+        {
+            if (file)
+            {
+                std::fclose(file);
+            }
+        };
+
+        reader(const reader&) = delete;
+        reader& operator=(const reader&) = delete;
+
+        bool is_open() const
+        {
+            return file != nullptr;
+        };
+
+        bool failed() const
+        {
+            return error;
+        };
+
+        // Steps into the top-level array.
+        bool begin()
+        {
+            return expect('[');
+        };
+
+        // Reads the next case, returning false at
+        // the end of the array (or on an error).
+        bool next(test_case& out)
+        {
+            char c = peek();
+            if (c == ',')
+            {
+                get();
+                c = peek();
+            }
+            if (c == ']' || c == 0)
+            {
+                return false;
+            }
+            if (!expect('{'))
+            {
+                return false;
+            }
+            out.initial.ram.clear();
+            out.final.ram.clear();
+            out.cycles = 0;
+            while (!error && peek() != '}')
+            {
+                std::string key = string();
+                expect(':');
+                if (key == "name")
+                {
+                    out.name = string();
+                }
+                else if (key == "initial")
+                {
+                    state(out.initial);
+                }
+                else if (key == "final")
+                {
+                    state(out.final);
+                }
+                else if (key == "cycles")
+                {
+                    out.cycles = count_elements();
+                }
+                else
+                {
+                    skip();
+                }
+                if (peek() == ',')
+                {
+                    get();
+                }
+            }
+            return expect('}');
+        };
+
+    private:
+        void state(cpu_state& out)
+        {
+            expect('{');
+            while (!error && peek() != '}')
+            {
+                std::string key = string();
+                expect(':');
+                if (key == "ram")
+                {
+                    expect('[');
+                    while (!error && peek() != ']')
+                    {
+                        expect('[');
+                        word addy = word(number());
+                        expect(',');
+                        byte value = byte(number());
+                        expect(']');
+                        out.ram.emplace_back(addy, value);
+                        if (peek() == ',')
+                        {
+                            get();
+                        }
+                    }
+                    expect(']');
+                }
+                else if (key == "pc")
+                {
+                    out.pc = word(number());
+                }
+                else if (key == "s")
+                {
+                    out.s = byte(number());
+                }
+                else if (key == "a")
+                {
+                    out.a = byte(number());
+                }
+                else if (key == "x")
+                {
+                    out.x = byte(number());
+                }
+                else if (key == "y")
+                {
+                    out.y = byte(number());
+                }
+                else if (key == "p")
+                {
+                    out.p = byte(number());
+                }
+                else
+                {
+                    skip();
+                }
+                if (peek() == ',')
+                {
+                    get();
+                }
+            }
+            expect('}');
+        };
+
+        // Counts the elements of an array without
+        // keeping any of them.
+        size_t count_elements()
+        {
+            expect('[');
+            size_t count = 0;
+            while (!error && peek() != ']')
+            {
+                skip();
+                ++count;
+                if (peek() == ',')
+                {
+                    get();
+                }
+            }
+            expect(']');
+            return count;
+        };
+
+        void skip()
+        {
+            char c = peek();
+            if (c == '"')
+            {
+                string();
+            }
+            else if (c == '[' || c == '{')
+            {
+                char close = c == '[' ? ']' : '}';
+                get();
+                while (!error && peek() != close)
+                {
+                    if (c == '{')
+                    {
+                        string();
+                        expect(':');
+                    }
+                    skip();
+                    if (peek() == ',')
+                    {
+                        get();
+                    }
+                }
+                expect(close);
+            }
+            else
+            {
+                // Numbers, true, false and null.
+                while (!error && peek() != ',' && peek() != ']' && peek() != '}' && peek() != 0)
+                {
+                    get();
+                }
+            }
+        };
+
+        std::string string()
+        {
+            std::string out;
+            if (!expect('"'))
+            {
+                return out;
+            }
+            while (true)
+            {
+                char c = get();
+                if (c == '"' || c == 0)
+                {
+                    break;
+                }
+                if (c == '\\')
+                {
+                    c = get();
+                }
+                out += c;
+            }
+            return out;
+        };
+
+        uint64_t number()
+        {
+            peek();
+            uint64_t value = 0;
+            bool any = false;
+            while (true)
+            {
+                char c = peek_raw();
+                if (c < '0' || c > '9')
+                {
+                    break;
+                }
+                value = value * 10 + (c - '0');
+                any = true;
+                get();
+            }
+            error |= !any;
+            return value;
+        };
+
+        bool expect(char c)
+        {
+            if (peek() != c)
+            {
+                error = true;
+                return false;
+            }
+            get();
+            return true;
+        };
+
+        // The next character that isn't whitespace,
+        // without taking it.
+        char peek()
+        {
+            while (true)
+            {
+                char c = peek_raw();
+                if (c != ' ' && c != '\n' && c != '\r' && c != '\t')
+                {
+                    return c;
+                }
+                get();
+            }
+        };
+
+        char peek_raw()
+        {
+            if (position == length && !refill())
+            {
+                return 0;
+            }
+            return buffer[position];
+        };
+
+        char get()
+        {
+            if (position == length && !refill())
+            {
+                return 0;
+            }
+            return buffer[position++];
+        };
+
+        bool refill()
+        {
+            length = file ? std::fread(buffer.data(), 1, buffer.size(), file) : 0;
+            position = 0;
+            return length > 0;
+        };
+
+        std::FILE* file = nullptr;
+        std::array<char, 1 << 16> buffer = {};
+        size_t position = 0;
+        size_t length = 0;
+        bool error = false;
+    };
+
+    struct file_result
+    {
+        std::filesystem::path path;
+        size_t passed = 0;
+        size_t failed = 0;
+        bool unreadable = false;
+        std::string first_failure;
+    };
+
+    // Runs one case on a CPU with flat memory,
+    // returning what went wrong, if anything.
+    std::string run_case(emulatte::cpu& processor, const test_case& test)
+    {
+        auto& memory = processor.memory;
+        processor.PC = test.initial.pc;
+        processor.S = test.initial.s;
+        processor.A = test.initial.a;
+        processor.X = test.initial.x;
+        processor.Y = test.initial.y;
+        processor.P.value = test.initial.p;
+        processor.jammed = false;
+        processor.cycles = 0;
+        for (auto [addy, value] : test.initial.ram)
+        {
+            memory.write(addy, value);
+        }
+
+        processor.step();
+
+        std::string problems;
+        auto check = [&](const char* what, unsigned got, unsigned expected)
+        {
+            if (got != expected)
+            {
+                problems += fmt::format(" {}={:X} (expected {:X})", what, got, expected);
+            }
+        };
+        check("pc", processor.PC.value, test.final.pc);
+        check("s", processor.S, test.final.s);
+        check("a", processor.A, test.final.a);
+        check("x", processor.X, test.final.x);
+        check("y", processor.Y, test.final.y);
+        check("p", processor.P.value, test.final.p);
+        check("cycles", unsigned(processor.cycles), unsigned(test.cycles));
+        for (auto [addy, value] : test.final.ram)
+        {
+            check(fmt::format("[{:04X}]", addy).c_str(), memory.read(addy), value);
+        }
+
+        // Put memory back the way we found it, so
+        // nothing leaks into the next case.
+        for (auto [addy, value] : test.initial.ram)
+        {
+            memory.write(addy, 0);
+        }
+        for (auto [addy, value] : test.final.ram)
+        {
+            memory.write(addy, 0);
+        }
+        return problems;
+    };
+
+    void run_file(file_result& result, bool verbose)
+    {
+        reader in{ result.path };
+        if (!in.is_open() || !in.begin())
+        {
+            result.unreadable = true;
+            return;
+        }
+
+        // One CPU, mapped flat, runs every case in
+        // the file. Its bus keeps several KB of page
+        // pointers, so it goes on the heap.
+        auto processor = std::make_unique<emulatte::cpu>();
+        processor->memory.map_flat();
+        processor->skip_idle_loops = false;
+
+        test_case test;
+        while (in.next(test))
+        {
+            std::string problems = run_case(*processor, test);
+            if (problems.empty())
+            {
+                ++result.passed;
+                continue;
+            }
+            ++result.failed;
+            if (result.first_failure.empty())
+            {
+                result.first_failure = test.name + ":" + problems;
+            }
+            if (verbose)
+            {
+                spdlog::warn("{} {}:{}", result.path.filename().string(), test.name, problems);
+            }
+        }
+        result.unreadable = in.failed();
+    };
+};
+
+int main(int argc, char** argv)
+{
+    std::vector<std::filesystem::path> files;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool verbose = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--jobs" && i + 1 < argc)
+        {
+            jobs = std::max(1u, unsigned(std::strtoul(argv[++i], nullptr, 10)));
+        }
+        else if (arg == "--verbose")
+        {
+            verbose = true;
+        }
+        else if (std::filesystem::is_directory(arg))
+        {
+            for (const auto& entry : std::filesystem::directory_iterator(arg))
+            {
+                if (entry.path().extension() == ".json")
+                {
+                    files.push_back(entry.path());
+                }
+            }
+        }
+        else
+        {
+            files.emplace_back(arg);
+        }
+    }
+
+    if (files.empty())
+    {
+        spdlog::error("usage: emulatte-conformance <dir or .json files...> [--jobs N] [--verbose]");
+        return 1;
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<file_result> results(files.size());
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        results[i].path = files[i];
+    }
+
+    // Files are handed out one at a time, so a
+    // slow one doesn't hold the rest up.
+    std::atomic<size_t> next_file = 0;
+    {
+        std::vector<std::jthread> workers;
+        for (unsigned i = 0; i < std::min<size_t>(jobs, files.size()); ++i)
+        {
+            workers.emplace_back([&]
+            {
+                for (size_t index = next_file++; index < results.size(); index = next_file++)
+                {
+                    run_file(results[index], verbose);
+                }
+            });
+        }
+    }
+
+    size_t passed = 0;
+    size_t failed = 0;
+    size_t bad_files = 0;
+    for (const file_result& result : results)
+    {
+        passed += result.passed;
+        failed += result.failed;
+        if (result.unreadable)
+        {
+            ++bad_files;
+            spdlog::error("{}: couldn't parse (after {} cases)", result.path.string(),
+                          result.passed + result.failed);
+        }
+        if (result.failed)
+        {
+            spdlog::warn("{}: {} of {} failed, first {}", result.path.filename().string(), result.failed,
+                         result.passed + result.failed, result.first_failure);
+        }
+    }
+
+    spdlog::info("{} files, {} cases passed, {} failed", files.size(), passed, failed);
+    return failed || bad_files ? 1 : 0;
+};
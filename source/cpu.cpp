@@ -0,0 +1,1121 @@
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+#include "cpu.hpp"
+#include "fundamentals.hpp"
+#include "region.hpp"
+
+// The CPU's interpreter. It's all templates on
+// the region, so it's explicitly instantiated
+// here for each one, and cpu.hpp tells every
+// other file not to instantiate it themselves.
+namespace emulatte
+{
+    // By using an array sorted by opcode value, we
+    // can effectively index each opcode directly,
+    // simply given a byte. It's all constants, so
+    // it's built into the binary as is.
+    const std::array<instruction, 0x100> instruction_set =
+    { {
+        { 0, "BRK", instruction::addressing_mode::Implicit, 7, instruction::access_type::Read },
+        { 1, "ORA", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Read },
+        { 2, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 3, "SLO", instruction::addressing_mode::IndirectX, 8, instruction::access_type::ReadModifyWrite },
+        { 4, "NOP", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 5, "ORA", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 6, "ASL", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 7, "SLO", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 8, "PHP", instruction::addressing_mode::Implicit, 3, instruction::access_type::Read },
+        { 9, "ORA", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 10, "ASL", instruction::addressing_mode::Accumulator, 2, instruction::access_type::ReadModifyWrite },
+        { 11, "ANC", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 12, "NOP", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 13, "ORA", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 14, "ASL", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 15, "SLO", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 16, "BPL", instruction::addressing_mode::Relative, 2, instruction::access_type::Read },
+        { 17, "ORA", instruction::addressing_mode::IndirectY, 5, instruction::access_type::Read },
+        { 18, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 19, "SLO", instruction::addressing_mode::IndirectY, 8, instruction::access_type::ReadModifyWrite },
+        { 20, "NOP", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 21, "ORA", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 22, "ASL", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 23, "SLO", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 24, "CLC", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 25, "ORA", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 26, "NOP", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 27, "SLO", instruction::addressing_mode::AbsoluteY, 7, instruction::access_type::ReadModifyWrite },
+        { 28, "NOP", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 29, "ORA", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 30, "ASL", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 31, "SLO", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 32, "JSR", instruction::addressing_mode::Absolute, 6, instruction::access_type::None },
+        { 33, "AND", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Read },
+        { 34, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 35, "RLA", instruction::addressing_mode::IndirectX, 8, instruction::access_type::ReadModifyWrite },
+        { 36, "BIT", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 37, "AND", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 38, "ROL", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 39, "RLA", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 40, "PLP", instruction::addressing_mode::Implicit, 4, instruction::access_type::Read },
+        { 41, "AND", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 42, "ROL", instruction::addressing_mode::Accumulator, 2, instruction::access_type::ReadModifyWrite },
+        { 43, "ANC", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 44, "BIT", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 45, "AND", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 46, "ROL", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 47, "RLA", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 48, "BMI", instruction::addressing_mode::Relative, 2, instruction::access_type::Read },
+        { 49, "AND", instruction::addressing_mode::IndirectY, 5, instruction::access_type::Read },
+        { 50, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 51, "RLA", instruction::addressing_mode::IndirectY, 8, instruction::access_type::ReadModifyWrite },
+        { 52, "NOP", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 53, "AND", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 54, "ROL", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 55, "RLA", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 56, "SEC", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 57, "AND", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 58, "NOP", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 59, "RLA", instruction::addressing_mode::AbsoluteY, 7, instruction::access_type::ReadModifyWrite },
+        { 60, "NOP", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 61, "AND", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 62, "ROL", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 63, "RLA", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 64, "RTI", instruction::addressing_mode::Implicit, 6, instruction::access_type::Read },
+        { 65, "EOR", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Read },
+        { 66, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 67, "SRE", instruction::addressing_mode::IndirectX, 8, instruction::access_type::ReadModifyWrite },
+        { 68, "NOP", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 69, "EOR", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 70, "LSR", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 71, "SRE", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 72, "PHA", instruction::addressing_mode::Implicit, 3, instruction::access_type::Read },
+        { 73, "EOR", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 74, "LSR", instruction::addressing_mode::Accumulator, 2, instruction::access_type::ReadModifyWrite },
+        { 75, "ALR", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 76, "JMP", instruction::addressing_mode::Absolute, 3, instruction::access_type::None },
+        { 77, "EOR", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 78, "LSR", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 79, "SRE", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 80, "BVC", instruction::addressing_mode::Relative, 2, instruction::access_type::Read },
+        { 81, "EOR", instruction::addressing_mode::IndirectY, 5, instruction::access_type::Read },
+        { 82, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 83, "SRE", instruction::addressing_mode::IndirectY, 8, instruction::access_type::ReadModifyWrite },
+        { 84, "NOP", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 85, "EOR", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 86, "LSR", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 87, "SRE", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 88, "CLI", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 89, "EOR", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 90, "NOP", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 91, "SRE", instruction::addressing_mode::AbsoluteY, 7, instruction::access_type::ReadModifyWrite },
+        { 92, "NOP", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 93, "EOR", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 94, "LSR", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 95, "SRE", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 96, "RTS", instruction::addressing_mode::Implicit, 6, instruction::access_type::Read },
+        { 97, "ADC", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Read },
+        { 98, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 99, "RRA", instruction::addressing_mode::IndirectX, 8, instruction::access_type::ReadModifyWrite },
+        { 100, "NOP", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 101, "ADC", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 102, "ROR", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 103, "RRA", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 104, "PLA", instruction::addressing_mode::Implicit, 4, instruction::access_type::Read },
+        { 105, "ADC", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 106, "ROR", instruction::addressing_mode::Accumulator, 2, instruction::access_type::ReadModifyWrite },
+        { 107, "ARR", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 108, "JMP", instruction::addressing_mode::Indirect, 5, instruction::access_type::None },
+        { 109, "ADC", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 110, "ROR", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 111, "RRA", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 112, "BVS", instruction::addressing_mode::Relative, 2, instruction::access_type::Read },
+        { 113, "ADC", instruction::addressing_mode::IndirectY, 5, instruction::access_type::Read },
+        { 114, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 115, "RRA", instruction::addressing_mode::IndirectY, 8, instruction::access_type::ReadModifyWrite },
+        { 116, "NOP", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 117, "ADC", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 118, "ROR", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 119, "RRA", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 120, "SEI", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 121, "ADC", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 122, "NOP", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 123, "RRA", instruction::addressing_mode::AbsoluteY, 7, instruction::access_type::ReadModifyWrite },
+        { 124, "NOP", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 125, "ADC", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 126, "ROR", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 127, "RRA", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 128, "NOP", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 129, "STA", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Write },
+        { 130, "NOP", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 131, "SAX", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Write },
+        { 132, "STY", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Write },
+        { 133, "STA", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Write },
+        { 134, "STX", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Write },
+        { 135, "SAX", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Write },
+        { 136, "DEY", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 137, "NOP", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 138, "TXA", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 139, "ANE", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 140, "STY", instruction::addressing_mode::Absolute, 4, instruction::access_type::Write },
+        { 141, "STA", instruction::addressing_mode::Absolute, 4, instruction::access_type::Write },
+        { 142, "STX", instruction::addressing_mode::Absolute, 4, instruction::access_type::Write },
+        { 143, "SAX", instruction::addressing_mode::Absolute, 4, instruction::access_type::Write },
+        { 144, "BCC", instruction::addressing_mode::Relative, 2, instruction::access_type::Read },
+        { 145, "STA", instruction::addressing_mode::IndirectY, 6, instruction::access_type::Write },
+        { 146, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 147, "SHA", instruction::addressing_mode::IndirectY, 6, instruction::access_type::Write },
+        { 148, "STY", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Write },
+        { 149, "STA", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Write },
+        { 150, "STX", instruction::addressing_mode::ZeroPageY, 4, instruction::access_type::Write },
+        { 151, "SAX", instruction::addressing_mode::ZeroPageY, 4, instruction::access_type::Write },
+        { 152, "TYA", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 153, "STA", instruction::addressing_mode::AbsoluteY, 5, instruction::access_type::Write },
+        { 154, "TXS", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 155, "TAS", instruction::addressing_mode::AbsoluteY, 5, instruction::access_type::Write },
+        { 156, "SHY", instruction::addressing_mode::AbsoluteX, 5, instruction::access_type::Write },
+        { 157, "STA", instruction::addressing_mode::AbsoluteX, 5, instruction::access_type::Write },
+        { 158, "SHX", instruction::addressing_mode::AbsoluteY, 5, instruction::access_type::Write },
+        { 159, "SHA", instruction::addressing_mode::AbsoluteY, 5, instruction::access_type::Write },
+        { 160, "LDY", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 161, "LDA", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Read },
+        { 162, "LDX", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 163, "LAX", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Read },
+        { 164, "LDY", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 165, "LDA", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 166, "LDX", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 167, "LAX", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 168, "TAY", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 169, "LDA", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 170, "TAX", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 171, "LXA", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 172, "LDY", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 173, "LDA", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 174, "LDX", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 175, "LAX", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 176, "BCS", instruction::addressing_mode::Relative, 2, instruction::access_type::Read },
+        { 177, "LDA", instruction::addressing_mode::IndirectY, 5, instruction::access_type::Read },
+        { 178, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 179, "LAX", instruction::addressing_mode::IndirectY, 5, instruction::access_type::Read },
+        { 180, "LDY", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 181, "LDA", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 182, "LDX", instruction::addressing_mode::ZeroPageY, 4, instruction::access_type::Read },
+        { 183, "LAX", instruction::addressing_mode::ZeroPageY, 4, instruction::access_type::Read },
+        { 184, "CLV", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 185, "LDA", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 186, "TSX", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 187, "LAS", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 188, "LDY", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 189, "LDA", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 190, "LDX", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 191, "LAX", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 192, "CPY", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 193, "CMP", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Read },
+        { 194, "NOP", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 195, "DCP", instruction::addressing_mode::IndirectX, 8, instruction::access_type::ReadModifyWrite },
+        { 196, "CPY", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 197, "CMP", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 198, "DEC", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 199, "DCP", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 200, "INY", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 201, "CMP", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 202, "DEX", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 203, "SBX", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 204, "CPY", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 205, "CMP", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 206, "DEC", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 207, "DCP", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 208, "BNE", instruction::addressing_mode::Relative, 2, instruction::access_type::Read },
+        { 209, "CMP", instruction::addressing_mode::IndirectY, 5, instruction::access_type::Read },
+        { 210, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 211, "DCP", instruction::addressing_mode::IndirectY, 8, instruction::access_type::ReadModifyWrite },
+        { 212, "NOP", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 213, "CMP", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 214, "DEC", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 215, "DCP", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 216, "CLD", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 217, "CMP", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 218, "NOP", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 219, "DCP", instruction::addressing_mode::AbsoluteY, 7, instruction::access_type::ReadModifyWrite },
+        { 220, "NOP", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 221, "CMP", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 222, "DEC", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 223, "DCP", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 224, "CPX", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 225, "SBC", instruction::addressing_mode::IndirectX, 6, instruction::access_type::Read },
+        { 226, "NOP", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 227, "ISC", instruction::addressing_mode::IndirectX, 8, instruction::access_type::ReadModifyWrite },
+        { 228, "CPX", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 229, "SBC", instruction::addressing_mode::ZeroPage, 3, instruction::access_type::Read },
+        { 230, "INC", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 231, "ISC", instruction::addressing_mode::ZeroPage, 5, instruction::access_type::ReadModifyWrite },
+        { 232, "INX", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 233, "SBC", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 234, "NOP", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 235, "USBC", instruction::addressing_mode::Immediate, 2, instruction::access_type::Read },
+        { 236, "CPX", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 237, "SBC", instruction::addressing_mode::Absolute, 4, instruction::access_type::Read },
+        { 238, "INC", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 239, "ISC", instruction::addressing_mode::Absolute, 6, instruction::access_type::ReadModifyWrite },
+        { 240, "BEQ", instruction::addressing_mode::Relative, 2, instruction::access_type::Read },
+        { 241, "SBC", instruction::addressing_mode::IndirectY, 5, instruction::access_type::Read },
+        { 242, "JAM", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 243, "ISC", instruction::addressing_mode::IndirectY, 8, instruction::access_type::ReadModifyWrite },
+        { 244, "NOP", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 245, "SBC", instruction::addressing_mode::ZeroPageX, 4, instruction::access_type::Read },
+        { 246, "INC", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 247, "ISC", instruction::addressing_mode::ZeroPageX, 6, instruction::access_type::ReadModifyWrite },
+        { 248, "SED", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 249, "SBC", instruction::addressing_mode::AbsoluteY, 4, instruction::access_type::Read },
+        { 250, "NOP", instruction::addressing_mode::Implicit, 2, instruction::access_type::Read },
+        { 251, "ISC", instruction::addressing_mode::AbsoluteY, 7, instruction::access_type::ReadModifyWrite },
+        { 252, "NOP", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 253, "SBC", instruction::addressing_mode::AbsoluteX, 4, instruction::access_type::Read },
+        { 254, "INC", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite },
+        { 255, "ISC", instruction::addressing_mode::AbsoluteX, 7, instruction::access_type::ReadModifyWrite }
+    } };
+
+    template <typename Region>
+    word basic_cpu<Region>::effective_address(instruction::addressing_mode mode, std::pair<byte, byte>& operands, bool& crossed)
+    {
+        using enum instruction::addressing_mode;
+        word base = address{ operands.first, operands.second }.value;
+        switch (mode)
+        {
+        case ZeroPage:
+            return operands.first;
+        // Zero page indexing wraps around within
+        // zero page, it never reaches page 1.
+        case ZeroPageX:
+            return byte(operands.first + X);
+        case ZeroPageY:
+            return byte(operands.first + Y);
+        case Absolute:
+            return base;
+        case AbsoluteX:
+            crossed = ((base + X) ^ base) & 0xFF00;
+            return base + X;
+        case AbsoluteY:
+            crossed = ((base + Y) ^ base) & 0xFF00;
+            return base + Y;
+        case Indirect:
+            // The famous JMP bug: the pointer's high
+            // byte is fetched without carrying into
+            // the next page.
+            return address{ memory.read(base),
+                            memory.read((base & 0xFF00) | byte(base + 1)) }.value;
+        case IndirectX:
+        {
+            byte pointer = operands.first + X;
+            return address{ memory.read(pointer), memory.read(byte(pointer + 1)) }.value;
+        }
+        case IndirectY:
+        {
+            word pointed = address{ memory.read(operands.first), memory.read(byte(operands.first + 1)) }.value;
+            crossed = ((pointed + Y) ^ pointed) & 0xFF00;
+            return pointed + Y;
+        }
+        default:
+            return 0;
+        }
+    };
+
+    template <typename Region>
+    void basic_cpu<Region>::handle_instruction(instruction inst)
+    {
+        word from = PC.value;
+        std::pair<byte, byte> operands = {};
+        byte bytes_consumed = 1;
+        byte cycles_taken = inst.cycles;
+
+        using enum instruction::addressing_mode;
+        switch (inst.mode)
+        {
+        case Immediate:
+        case ZeroPage:
+        case ZeroPageX:
+        case ZeroPageY:
+        case Relative:
+        case IndirectX:
+        case IndirectY:
+            operands.first = memory.read(PC.value + 1);
+            bytes_consumed = 2;
+            break;
+        case Indirect:
+        case Absolute:
+        case AbsoluteX:
+        case AbsoluteY:
+            operands.first = memory.read(PC.value + 1);
+            operands.second = memory.read(PC.value + 2);
+            bytes_consumed = 3;
+            break;
+        default:
+            break;
+        }
+
+        // We work on a copy of the operand and
+        // write it back at the end, so that only
+        // the instructions that really read or
+        // write memory go through the bus.
+        using enum instruction::access_type;
+        bool crossed = false;
+        bool in_memory = inst.mode != Implicit && inst.mode != Accumulator &&
+                         inst.mode != Immediate && inst.mode != Relative;
+        word effective = in_memory ? effective_address(inst.mode, operands, crossed) : 0;
+        byte operand = 0;
+        if (!in_memory)
+        {
+            operand = (inst.mode == Immediate || inst.mode == Relative) ? operands.first : A;
+        }
+        else if (inst.access == Read || inst.access == ReadModifyWrite)
+        {
+            operand = memory.read(effective);
+        }
+
+        // Reads that index across a page boundary
+        // cost an extra cycle. Stores and RMW ops
+        // always pay it, so it's already part of
+        // their base count.
+        if (crossed && inst.access == Read)
+        {
+            ++cycles_taken;
+        }
+
+        switch (inst.value)
+        {
+        case 0x69:
+        case 0x65:
+        case 0x75:
+        case 0x6D:
+        case 0x7D:
+        case 0x79:
+        case 0x61:
+        case 0x71: // ADC
+            add_with_carry(operand);
+            break;
+        case 0xE9:
+        case 0xE5:
+        case 0xF5:
+        case 0xED:
+        case 0xFD:
+        case 0xF9:
+        case 0xE1:
+        case 0xF1: // SBC
+        case 0xEB: // USBC
+            // Subtracting is adding the complement,
+            // with carry meaning "no borrow".
+            add_with_carry(~operand);
+            break;
+        case 0x29:
+        case 0x25:
+        case 0x35:
+        case 0x2D:
+        case 0x3D:
+        case 0x39:
+        case 0x21:
+        case 0x31: // AND
+            A &= operand;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0x09:
+        case 0x05:
+        case 0x15:
+        case 0x0D:
+        case 0x1D:
+        case 0x19:
+        case 0x01:
+        case 0x11: // ORA
+            A |= operand;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0x49:
+        case 0x45:
+        case 0x55:
+        case 0x4D:
+        case 0x5D:
+        case 0x59:
+        case 0x41:
+        case 0x51: // EOR
+            A ^= operand;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0x0A:
+        case 0x06:
+        case 0x16:
+        case 0x0E:
+        case 0x1E: // ASL
+            P.C = bool(operand & 0b1000'0000);
+            operand <<= 1;
+            P.N = bool(operand & 0b1000'0000);
+            P.Z = operand == 0;
+            break;
+        case 0x4A:
+        case 0x46:
+        case 0x56:
+        case 0x4E:
+        case 0x5E: // LSR
+            P.C = bool(operand & 0b0000'0001);
+            operand >>= 1;
+            P.N = bool(operand & 0b1000'0000);
+            P.Z = operand == 0;
+            break;
+        case 0x2A:
+        case 0x26:
+        case 0x36:
+        case 0x2E:
+        case 0x3E: // ROL
+        {
+            word result = operand << 1;
+            result |= P.C;
+            P.C = bool(result & 0b1'0000'0000);
+            operand = result & 0b1111'1111;
+            P.N = bool(operand & 0b1000'0000);
+            P.Z = operand == 0;
+            break;
+        }
+        case 0x6A:
+        case 0x66:
+        case 0x76:
+        case 0x6E:
+        case 0x7E: // ROR
+        {
+            word result = operand;
+            result |= word(P.C) << 8;
+            P.C = result & 0b0000'0001;
+            operand = result >> 1;
+            P.N = bool(operand & 0b1000'0000);
+            P.Z = operand == 0;
+            break;
+        }
+        case 0xA9:
+        case 0xA5:
+        case 0xB5:
+        case 0xAD:
+        case 0xBD:
+        case 0xB9:
+        case 0xA1:
+        case 0xB1: // LDA
+            A = operand;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0xA2:
+        case 0xA6:
+        case 0xB6:
+        case 0xAE:
+        case 0xBE: // LDX
+            X = operand;
+            P.N = bool(X & 0b1000'0000);
+            P.Z = X == 0;
+            break;
+        case 0xA0:
+        case 0xA4:
+        case 0xB4:
+        case 0xAC:
+        case 0xBC: // LDY
+            Y = operand;
+            P.N = bool(Y & 0b1000'0000);
+            P.Z = Y == 0;
+            break;
+        case 0x85:
+        case 0x95:
+        case 0x8D:
+        case 0x9D:
+        case 0x99:
+        case 0x81:
+        case 0x91: // STA
+            operand = A;
+            break;
+        case 0x86:
+        case 0x96:
+        case 0x8E: // STX
+            operand = X;
+            break;
+        case 0x84:
+        case 0x94:
+        case 0x8C: // STY
+            operand = Y;
+            break;
+        case 0xC6:
+        case 0xD6:
+        case 0xCE:
+        case 0xDE: // DEC
+            --operand;
+            P.N = bool(operand & 0b1000'0000);
+            P.Z = operand == 0;
+            break;
+        case 0xCA: // DEX
+            --X;
+            P.N = bool(X & 0b1000'0000);
+            P.Z = X == 0;
+            break;
+        case 0x88: // DEY
+            --Y;
+            P.N = bool(Y & 0b1000'0000);
+            P.Z = Y == 0;
+            break;
+        case 0xE6:
+        case 0xF6:
+        case 0xEE:
+        case 0xFE: // INC
+            ++operand;
+            P.N = bool(operand & 0b1000'0000);
+            P.Z = operand == 0;
+            break;
+        case 0xE8: // INX
+            ++X;
+            P.N = bool(X & 0b1000'0000);
+            P.Z = X == 0;
+            break;
+        case 0xC8: // INY
+            ++Y;
+            P.N = bool(Y & 0b1000'0000);
+            P.Z = Y == 0;
+            break;
+        case 0xC9:
+        case 0xC5:
+        case 0xD5:
+        case 0xCD:
+        case 0xDD:
+        case 0xD9:
+        case 0xC1:
+        case 0xD1: // CMP
+            if (A < operand)
+            {
+                P.N = bool((A - operand) & 0b1000'0000);
+                P.Z = 0;
+                P.C = 0;
+            }
+            else if (A > operand)
+            {
+                P.N = bool((A - operand) & 0b1000'0000);
+                P.Z = 0;
+                P.C = 1;
+            }
+            else if (A == operand)
+            {
+                P.N = 0;
+                P.Z = 1;
+                P.C = 1;
+            }
+            break;
+        case 0xE0:
+        case 0xE4:
+        case 0xEC: // CPX
+            if (X < operand)
+            {
+                P.N = bool((X - operand) & 0b1000'0000);
+                P.Z = 0;
+                P.C = 0;
+            }
+            else if (X > operand)
+            {
+                P.N = bool((X - operand) & 0b1000'0000);
+                P.Z = 0;
+                P.C = 1;
+            }
+            else if (X == operand)
+            {
+                P.N = 0;
+                P.Z = 1;
+                P.C = 1;
+            }
+            break;
+        case 0xC0:
+        case 0xC4:
+        case 0xCC: // CPY
+            if (Y < operand)
+            {
+                P.N = bool((Y - operand) & 0b1000'0000);
+                P.Z = 0;
+                P.C = 0;
+            }
+            else if (Y > operand)
+            {
+                P.N = bool((Y - operand) & 0b1000'0000);
+                P.Z = 0;
+                P.C = 1;
+            }
+            else if (Y == operand)
+            {
+                P.N = 0;
+                P.Z = 1;
+                P.C = 1;
+            }
+            break;
+        case 0x90: // BCC
+            if (P.C == 0)
+            {
+                branch(operand, cycles_taken);
+            }
+            break;
+        case 0xB0: // BCS
+            if (P.C == 1)
+            {
+                branch(operand, cycles_taken);
+            }
+            break;
+        case 0xD0: // BNE
+            if (P.Z == 0)
+            {
+                branch(operand, cycles_taken);
+            }
+            break;
+        case 0xF0: // BEQ
+            if (P.Z == 1)
+            {
+                branch(operand, cycles_taken);
+            }
+            break;
+        case 0x10: // BPL
+            if (P.N == 0)
+            {
+                branch(operand, cycles_taken);
+            }
+            break;
+        case 0x30: // BMI
+            if (P.N == 1)
+            {
+                branch(operand, cycles_taken);
+            }
+            break;
+        case 0x50: // BVC
+            if (P.V == 0)
+            {
+                branch(operand, cycles_taken);
+            }
+            break;
+        case 0x70: // BVS
+            if (P.V == 1)
+            {
+                branch(operand, cycles_taken);
+            }
+            break;
+        case 0x18: // CLC
+            P.C = 0;
+            break;
+        case 0x38: // SEC
+            P.C = 1;
+            break;
+        case 0xD8: // CLD
+            P.b3 = 0;
+            break;
+        case 0xF8: // SED
+            P.b3 = 1;
+            break;
+        case 0x58: // CLI
+            P.I = 0;
+            irq_check();
+            break;
+        case 0x78: // SEI
+            P.I = 1;
+            break;
+        case 0xB8: // CLV
+            P.V = 0;
+            break;
+        case 0x24:
+        case 0x2C: // BIT
+            P.N = bool(operand & 0b1000'0000);
+            P.V = bool(operand & 0b0100'0000);
+            P.Z = (A & operand) == 0;
+            break;
+        case 0x00: // BRK
+            // BRK skips the byte after it, and is
+            // the only thing that pushes P with the
+            // B flag set besides PHP.
+            push(address{ PC + 2 });
+            push(byte(P.value | 0b0011'0000));
+            P.I = 1;
+            PC = address{ memory.read(0xFFFE), memory.read(0xFFFF) };
+            bytes_consumed = 0;
+            break;
+        case 0x4C: // JMP absolute
+            PC = address{ operands.first, operands.second };
+            bytes_consumed = 0;
+            break;
+        case 0x6C: // JMP indirect
+            PC = effective;
+            bytes_consumed = 0;
+            break;
+        case 0x20: // JSR
+            push(address{ PC + 2 });
+            PC = address{ operands.first, operands.second };
+            bytes_consumed = 0;
+            break;
+        case 0xEA: // NOP
+            break;
+        case 0x48: // PHA
+            push(A);
+            break;
+        case 0x08: // PHP
+            push(byte(P.value | 0b0011'0000));
+            break;
+        case 0x68: // PLA
+            A = pull();
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0x28: // PLP
+            // Bits 4 and 5 don't really exist in P,
+            // so whatever was pushed there is lost.
+            P.value = (pull() & 0b1100'1111) | (P.value & 0b0011'0000);
+            irq_check();
+            break;
+        case 0x40: // RTI
+            P.value = (pull() & 0b1100'1111) | (P.value & 0b0011'0000);
+            PC = pull_address();
+            bytes_consumed = 0;
+            irq_check();
+            break;
+        case 0x60: // RTS
+            // JSR pushed the address of its last
+            // byte, so the normal one byte advance
+            // below lands us on the next opcode.
+            PC = pull_address();
+            break;
+        case 0xAA: // TAX
+            X = A;
+            P.N = bool(X & 0b1000'0000);
+            P.Z = X == 0;
+            break;
+        case 0xA8: // TAY
+            Y = A;
+            P.N = bool(Y & 0b1000'0000);
+            P.Z = Y == 0;
+            break;
+        case 0x8A: // TXA
+            A = X;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0x98: // TYA
+            A = Y;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0xBA: // TSX
+            X = S;
+            P.N = bool(X & 0b1000'0000);
+            P.Z = X == 0;
+            break;
+        case 0x9A: // TXS
+            S = X;
+            break;
+        // The "illegal" opcodes. Most of them are
+        // two official ones glued together, run
+        // off the same decoded address.
+        case 0x03:
+        case 0x07:
+        case 0x0F:
+        case 0x13:
+        case 0x17:
+        case 0x1B:
+        case 0x1F: // SLO = ASL + ORA
+            P.C = bool(operand & 0b1000'0000);
+            operand <<= 1;
+            A |= operand;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0x23:
+        case 0x27:
+        case 0x2F:
+        case 0x33:
+        case 0x37:
+        case 0x3B:
+        case 0x3F: // RLA = ROL + AND
+        {
+            byte carry = P.C;
+            P.C = bool(operand & 0b1000'0000);
+            operand = (operand << 1) | carry;
+            A &= operand;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        }
+        case 0x43:
+        case 0x47:
+        case 0x4F:
+        case 0x53:
+        case 0x57:
+        case 0x5B:
+        case 0x5F: // SRE = LSR + EOR
+            P.C = bool(operand & 0b0000'0001);
+            operand >>= 1;
+            A ^= operand;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0x63:
+        case 0x67:
+        case 0x6F:
+        case 0x73:
+        case 0x77:
+        case 0x7B:
+        case 0x7F: // RRA = ROR + ADC
+        {
+            byte carry = P.C;
+            P.C = bool(operand & 0b0000'0001);
+            operand = (operand >> 1) | (carry << 7);
+            add_with_carry(operand);
+            break;
+        }
+        case 0x83:
+        case 0x87:
+        case 0x8F:
+        case 0x97: // SAX
+            operand = A & X;
+            break;
+        case 0xA3:
+        case 0xA7:
+        case 0xAF:
+        case 0xB3:
+        case 0xB7:
+        case 0xBF: // LAX = LDA + LDX
+            A = X = operand;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0xC3:
+        case 0xC7:
+        case 0xCF:
+        case 0xD3:
+        case 0xD7:
+        case 0xDB:
+        case 0xDF: // DCP = DEC + CMP
+            --operand;
+            P.N = bool(byte(A - operand) & 0b1000'0000);
+            P.Z = A == operand;
+            P.C = A >= operand;
+            break;
+        case 0xE3:
+        case 0xE7:
+        case 0xEF:
+        case 0xF3:
+        case 0xF7:
+        case 0xFB:
+        case 0xFF: // ISC = INC + SBC
+            ++operand;
+            add_with_carry(~operand);
+            break;
+        case 0x0B:
+        case 0x2B: // ANC
+            A &= operand;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            P.C = P.N;
+            break;
+        case 0x4B: // ALR = AND + LSR A
+            A &= operand;
+            P.C = bool(A & 0b0000'0001);
+            A >>= 1;
+            P.N = 0;
+            P.Z = A == 0;
+            break;
+        case 0x6B: // ARR = AND + ROR A, with odd flags
+            A &= operand;
+            A = (A >> 1) | (P.C << 7);
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            P.C = bool(A & 0b0100'0000);
+            P.V = bool(((A >> 6) ^ (A >> 5)) & 1);
+            break;
+        case 0x8B: // ANE
+        case 0xAB: // LXA
+            // Both depend on an analog "magic"
+            // constant that varies from chip to
+            // chip. $EE is the usual choice, and
+            // what the test corpora expect.
+            A = (A | 0xEE) & operand;
+            if (inst.value == 0x8B)
+            {
+                A &= X;
+            }
+            else
+            {
+                X = A;
+            }
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0xCB: // SBX
+        {
+            byte value = A & X;
+            P.C = value >= operand;
+            X = value - operand;
+            P.N = bool(X & 0b1000'0000);
+            P.Z = X == 0;
+            break;
+        }
+        case 0xBB: // LAS
+            A = X = S = operand & S;
+            P.N = bool(A & 0b1000'0000);
+            P.Z = A == 0;
+            break;
+        case 0x93:
+        case 0x9F: // SHA
+        case 0x9B: // TAS
+        case 0x9C: // SHY
+        case 0x9E: // SHX
+        {
+            // These store a register ANDed with the
+            // high byte of the base address plus
+            // one. If indexing crossed a page, that
+            // same value replaces the high byte of
+            // the address written to as well.
+            byte index = inst.value == 0x9C ? X : Y;
+            byte high = byte(((effective - index) >> 8) + 1);
+            switch (inst.value)
+            {
+            case 0x9C:
+                operand = Y & high;
+                break;
+            case 0x9E:
+                operand = X & high;
+                break;
+            case 0x9B:
+                S = A & X;
+                operand = S & high;
+                break;
+            default:
+                operand = A & X & high;
+                break;
+            }
+            if (crossed)
+            {
+                effective = (word(operand) << 8) | (effective & 0xFF);
+            }
+            break;
+        }
+        case 0x02:
+        case 0x12:
+        case 0x22:
+        case 0x32:
+        case 0x42:
+        case 0x52:
+        case 0x62:
+        case 0x72:
+        case 0x92:
+        case 0xB2:
+        case 0xD2:
+        case 0xF2: // JAM
+            // The CPU locks up until it's reset,
+            // ignoring interrupts. We just keep
+            // sitting on this opcode.
+            jammed = true;
+            bytes_consumed = 0;
+            break;
+        default: // The remaining NOPs.
+            break;
+        }
+
+        if (inst.access == Write || inst.access == ReadModifyWrite)
+        {
+            if (in_memory)
+            {
+                memory.write(effective, operand);
+            }
+            else
+            {
+                A = operand;
+            }
+        }
+
+        PC.value += bytes_consumed;
+        cycles += cycles_taken;
+
+        if ((inst.mode == Relative || inst.value == 0x4C || jammed) && PC.value <= from)
+        {
+            check_idle_loop();
+        }
+    };
+
+    template <typename Region>
+    void basic_cpu<Region>::check_idle_loop()
+    {
+        if (!skip_idle_loops)
+        {
+            return;
+        }
+
+        idle_loop now{ PC.value, A, X, Y, S, P.value, memory.side_effects, cycles };
+        if (now.repeats(idle) && cycles < run_limit)
+        {
+            uint64_t length = cycles - idle.cycles;
+            uint64_t skipped = (run_limit - cycles) / length * length;
+            cycles += skipped;
+            idle_cycles_skipped += skipped;
+            now.cycles = cycles;
+        }
+        idle = now;
+    };
+
+    template <typename Region>
+    void basic_cpu<Region>::add_with_carry(byte value)
+    {
+        word result = A + value + P.C;
+        P.V = bool((A ^ result) & (value ^ result) & 0b1000'0000);
+        P.C = result > 0xFF;
+        A = byte(result);
+        P.N = bool(A & 0b1000'0000);
+        P.Z = A == 0;
+    };
+
+    template <typename Region>
+    void basic_cpu<Region>::branch(byte offset, byte& cycles_taken)
+    {
+        word next = PC.value + 2;
+        word target = next + std::bit_cast<int8_t, byte>(offset);
+        cycles_taken += ((next ^ target) & 0xFF00) ? 2 : 1;
+        PC.value = target - 2;
+    };
+
+    template <typename Region>
+    void basic_cpu<Region>::step()
+    {
+        ++instructions;
+        handle_instruction(instruction_set[memory.read(PC.value)]);
+    };
+
+    template <typename Region>
+    void basic_cpu<Region>::run_until(uint64_t limit)
+    {
+        run_limit = limit;
+        if (breakpoints)
+        {
+            run<true>();
+        }
+        else
+        {
+            run<false>();
+        }
+    };
+
+    template <typename Region>
+    template <bool check_breakpoints>
+    void basic_cpu<Region>::run()
+    {
+        while (cycles < run_limit)
+        {
+            if constexpr (check_breakpoints)
+            {
+                if (breakpoints->test(PC.value) && PC.value != resume_from)
+                {
+                    stop_requested = true;
+                    return;
+                }
+                resume_from = -1;
+            }
+            step();
+        }
+    };
+
+    template struct basic_cpu<ntsc>;
+    template struct basic_cpu<pal>;
+    template struct basic_cpu<dendy>;
+};
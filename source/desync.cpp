@@ -0,0 +1,61 @@
+#include <cstdint>
+
+#include "spdlog/spdlog.h"
+
+#include "state_hash.hpp"
+
+// Compares two per-frame state hash logs, as
+// written by `emulatte --hash-log`. Usage:
+//
+//     emulatte-desync <a.log> <b.log>
+//
+// Names the first frame where the two runs
+// disagree, if there is one. Exits with 0 if the
+// logs match, 1 if they don't, and 2 if either
+// can't be read. A log that ends early counts
+// as not matching.
+int main(int argc, char** argv)
+{
+    if (argc != 3)
+    {
+        spdlog::error("usage: emulatte-desync <a.log> <b.log>");
+        return 2;
+    }
+
+    emulatte::state_hash_reader a;
+    emulatte::state_hash_reader b;
+    if (!a.open(argv[1]) || !b.open(argv[2]))
+    {
+        spdlog::error("couldn't read {} and {} as state hash logs", argv[1], argv[2]);
+        return 2;
+    }
+
+    uint64_t compared = 0;
+    emulatte::state_hash_record left;
+    emulatte::state_hash_record right;
+    while (true)
+    {
+        bool more_left = a.next(left);
+        bool more_right = b.next(right);
+        if (!more_left || !more_right)
+        {
+            if (more_left != more_right)
+            {
+                spdlog::error("{} stops after {} frames, but the other log goes on",
+                              more_left ? argv[2] : argv[1], compared);
+                return 1;
+            }
+            break;
+        }
+        if (left.frame != right.frame || left.hash != right.hash)
+        {
+            spdlog::error("desync at frame {}: {:016x} in {}, {:016x} (frame {}) in {}",
+                          left.frame, left.hash, argv[1], right.hash, right.frame, argv[2]);
+            return 1;
+        }
+        ++compared;
+    }
+
+    spdlog::info("{} frames match", compared);
+    return 0;
+};
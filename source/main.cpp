@@ -1,8 +1,294 @@
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+
 #include "spdlog/spdlog.h"
 
+#include "capture.hpp"
+#include "cartridge.hpp"
 #include "fundamentals.hpp"
+#include "region.hpp"
+#include "shared_frame.hpp"
+#include "shared_stats.hpp"
+#include "state_hash.hpp"
+#include "system.hpp"
+
+// Runs a ROM headlessly. Usage:
+//
+//     emulatte <rom> [--frames N] [--shm /name] [--hash-log path]
+//                    [--capture dir] [--capture-format raw|png|qoi]
+//                    [--capture-wait] [--save path] [--no-save]
+//                    [--region ntsc|pal|dendy] [--no-stats] [--no-idle-skip]
+//
+// Without --frames it runs until killed. With
+// --shm every finished frame, along with the
+// internal RAM, is published into the named
+// shared memory object (see shared_frame.hpp).
+// --hash-log writes a hash of the state after
+// every frame, for emulatte-desync to compare
+// against another run. --capture writes every
+// frame into the given directory from a
+// background thread (see capture.hpp), as raw
+// palette indices unless told otherwise. If the
+// disk can't keep up, frames are dropped (their
+// audio is kept) rather than slowing emulation
+// down; --capture-wait waits for it instead.
+// Carts with battery-backed RAM keep it in a
+// save file next to the ROM (the .nes swapped
+// for .sav), or wherever --save says; --no-save
+// leaves it in memory only.
+// --region picks the console to emulate; by
+// default it's whatever the ROM's header asks
+// for, which is nearly always NTSC.
+// Performance counters are published every
+// frame for emulatte-top to show (see
+// shared_stats.hpp), unless --no-stats.
+// --no-idle-skip emulates idle loops pass by
+// pass, for checking that skipping them doesn't
+// change anything.
+//
+// Anything else starting with a dash is a
+// mistake, and we say so rather than taking it
+// for the ROM.
+namespace
+{
+    constexpr const char* usage =
+        "usage: emulatte <rom> [--frames N] [--shm /name] [--hash-log path] "
+        "[--capture dir] [--capture-format raw|png|qoi] [--capture-wait] "
+        "[--save path] [--no-save] [--region ntsc|pal|dendy] [--no-stats] [--no-idle-skip]";
+
+    // Set by Ctrl-C or a kill, so we stop after the
+    // frame we're on and clean up after ourselves
+    // - the shared memory objects in particular
+    // would outlive us otherwise.
+    volatile std::sig_atomic_t interrupted = 0;
+
+    void interrupt(int)
+    {
+        interrupted = 1;
+    };
+
+    struct options
+    {
+        std::string rom_path;
+        std::string shm_name;
+        std::string hash_log_path;
+        std::string capture_path;
+        std::string save_path;
+        std::string region;
+        emulatte::capture::format capture_format = emulatte::capture::format::Raw;
+        emulatte::capture::overflow capture_overflow = emulatte::capture::overflow::Drop;
+        uint64_t frame_limit = 0;
+        bool use_save = true;
+        bool skip_idle_loops = true;
+        bool publish_stats = true;
+    };
+
+    // Everything after parsing the command line,
+    // built once for each region.
+    template <typename Region>
+    int run(options opts)
+    {
+        // The system is far too big for the stack.
+        auto nes = std::make_unique<emulatte::basic_system<Region>>();
+        if (!nes->load_rom(opts.rom_path))
+        {
+            spdlog::error("couldn't load {} (only iNES mapper 0 is supported)", opts.rom_path);
+            return 1;
+        }
+        if (nes->cart->battery && opts.use_save)
+        {
+            if (opts.save_path.empty())
+            {
+                opts.save_path = std::filesystem::path(opts.rom_path).replace_extension(".sav").string();
+            }
+            if (!nes->load_battery(opts.save_path))
+            {
+                spdlog::error("couldn't open save file {}", opts.save_path);
+                return 1;
+            }
+            spdlog::info("saving to {}", opts.save_path);
+        }
+        nes->processor.skip_idle_loops = opts.skip_idle_loops;
+        nes->reset();
+
+        emulatte::shared_frame_publisher publisher;
+        if (!opts.shm_name.empty())
+        {
+            if (!publisher.open(opts.shm_name))
+            {
+                spdlog::error("couldn't create shared memory object {}", opts.shm_name);
+                return 1;
+            }
+            spdlog::info("publishing frames to {}", opts.shm_name);
+        }
+
+        emulatte::shared_stats_publisher stats;
+        if (opts.publish_stats && !stats.open(std::filesystem::path(opts.rom_path).filename().string(), Region::name))
+        {
+            // Only for watching, so not worth
+            // stopping over.
+            spdlog::warn("couldn't publish stats to shared memory");
+        }
 
-int main()
+        emulatte::state_hash_writer hash_log;
+        if (!opts.hash_log_path.empty() && !hash_log.open(opts.hash_log_path))
+        {
+            spdlog::error("couldn't create hash log {}", opts.hash_log_path);
+            return 1;
+        }
+
+        emulatte::capture recorder;
+        if (!opts.capture_path.empty())
+        {
+            if (!recorder.open(opts.capture_path, opts.capture_format, opts.capture_overflow))
+            {
+                spdlog::error("couldn't capture into {}", opts.capture_path);
+                return 1;
+            }
+            spdlog::info("capturing frames into {}", opts.capture_path);
+        }
+
+        std::signal(SIGINT, interrupt);
+        std::signal(SIGTERM, interrupt);
+        while (!interrupted && (opts.frame_limit == 0 || nes->frame < opts.frame_limit))
+        {
+            nes->run_frame();
+            if (publisher.is_open())
+            {
+                publisher.publish(nes->frame, nes->framebuffer.data(), nes->ram());
+            }
+            if (hash_log.is_open())
+            {
+                hash_log.write(nes->frame, emulatte::hash_state(*nes));
+            }
+            if (recorder.is_open())
+            {
+                recorder.submit(nes->frame, nes->framebuffer.data());
+            }
+            if (stats.is_open())
+            {
+                stats.publish(nes->last_frame_counters, nes->counters());
+            }
+        }
+
+        if (recorder.is_open())
+        {
+            recorder.close();
+            if (recorder.dropped())
+            {
+                spdlog::warn("capture couldn't keep up and dropped {} frames", recorder.dropped());
+            }
+        }
+
+        spdlog::info("ran {} frames, {} cycles ({} skipped in idle loops)",
+                     nes->frame, nes->processor.cycles, nes->processor.idle_cycles_skipped);
+        return 0;
+    };
+};
+
+int main(int argc, char** argv)
 {
-    spdlog::info("Hello, world!");
-};
\ No newline at end of file
+    options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc)
+        {
+            opts.frame_limit = std::strtoull(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--shm" && i + 1 < argc)
+        {
+            opts.shm_name = argv[++i];
+        }
+        else if (arg == "--hash-log" && i + 1 < argc)
+        {
+            opts.hash_log_path = argv[++i];
+        }
+        else if (arg == "--capture" && i + 1 < argc)
+        {
+            opts.capture_path = argv[++i];
+        }
+        else if (arg == "--capture-format" && i + 1 < argc)
+        {
+            std::string_view name = argv[++i];
+            opts.capture_format = name == "png" ? emulatte::capture::format::Png
+                                : name == "qoi" ? emulatte::capture::format::Qoi
+                                                : emulatte::capture::format::Raw;
+        }
+        else if (arg == "--capture-wait")
+        {
+            opts.capture_overflow = emulatte::capture::overflow::Wait;
+        }
+        else if (arg == "--save" && i + 1 < argc)
+        {
+            opts.save_path = argv[++i];
+        }
+        else if (arg == "--no-save")
+        {
+            opts.use_save = false;
+        }
+        else if (arg == "--region" && i + 1 < argc)
+        {
+            opts.region = argv[++i];
+        }
+        else if (arg == "--no-stats")
+        {
+            opts.publish_stats = false;
+        }
+        else if (arg == "--no-idle-skip")
+        {
+            opts.skip_idle_loops = false;
+        }
+        else if (arg.starts_with("-"))
+        {
+            spdlog::error("{} isn't an option, or is missing its value", arg);
+            spdlog::error("{}", usage);
+            return 1;
+        }
+        else
+        {
+            opts.rom_path = arg;
+        }
+    }
+
+    if (opts.rom_path.empty())
+    {
+        spdlog::error("{}", usage);
+        return 1;
+    }
+
+    if (opts.region.empty())
+    {
+        // Only the header is needed to pick, but
+        // reading the whole ROM twice is no great
+        // loss, and it's where a bad file shows up.
+        emulatte::cartridge cart;
+        if (!cart.load(opts.rom_path))
+        {
+            spdlog::error("couldn't load {}", opts.rom_path);
+            return 1;
+        }
+        using timing = emulatte::cartridge::timing;
+        opts.region = cart.region == timing::Pal ? "pal" : cart.region == timing::Dendy ? "dendy" : "ntsc";
+    }
+
+    if (opts.region == "ntsc")
+    {
+        return run<emulatte::ntsc>(opts);
+    }
+    else if (opts.region == "pal")
+    {
+        return run<emulatte::pal>(opts);
+    }
+    else if (opts.region == "dendy")
+    {
+        return run<emulatte::dendy>(opts);
+    }
+    spdlog::error("unknown region {} (ntsc, pal or dendy)", opts.region);
+    return 1;
+};
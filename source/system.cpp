@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+#include "fundamentals.hpp"
+#include "region.hpp"
+#include "scheduler.hpp"
+#include "system.hpp"
+
+// The system's main loop and event handling,
+// compiled once for each region alongside the
+// CPU (see cpu.cpp).
+namespace emulatte
+{
+    template <typename Region>
+    void basic_system<Region>::run_frame()
+    {
+        // The clock is read once between the CPU and
+        // the events, and once after, so a batch
+        // costs two reads.
+        using clock = std::chrono::steady_clock;
+        auto nanoseconds = [](clock::duration span)
+        {
+            return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(span).count());
+        };
+
+        uint64_t target = frame + 1;
+        auto started = clock::now();
+        while (frame < target && !processor.stop_requested)
+        {
+            processor.run_until(events.cpu_deadline());
+            auto ran = clock::now();
+            service_events();
+            auto serviced = clock::now();
+            cpu_nanoseconds += nanoseconds(ran - started);
+            event_nanoseconds += nanoseconds(serviced - ran);
+            started = serviced;
+        }
+        if (frame >= target)
+        {
+            perf_counters now = counters();
+            last_frame_counters = now - frame_start_counters;
+            frame_start_counters = now;
+        }
+    };
+
+    template <typename Region>
+    void basic_system<Region>::step_instruction()
+    {
+        processor.run_limit = events.cpu_deadline();
+        processor.step();
+        service_events();
+    };
+
+    template <typename Region>
+    void basic_system<Region>::service_events()
+    {
+        scheduler_events::event type;
+        uint64_t time;
+        while (events.pop_due(type, time))
+        {
+            dispatch(type, time);
+            ++events_handled;
+        }
+        processor.irq();
+    };
+
+    template <typename Region>
+    void basic_system<Region>::dispatch(scheduler_events::event type, uint64_t time)
+    {
+        using enum scheduler_events::event;
+        auto& memory = processor.memory;
+        switch (type)
+        {
+        case FrameEnd:
+            ++frame;
+            events.schedule(FrameEnd, time + frame_length);
+            break;
+        case VblankStart:
+            video.status |= 0x80;
+            ++memory.side_effects;
+            if (video.control & 0x80)
+            {
+                processor.nmi();
+            }
+            events.schedule(VblankStart, time + frame_length);
+            break;
+        case VblankEnd:
+            // This also clears sprite 0 hit and
+            // sprite overflow, not that anything
+            // sets them yet.
+            video.status &= 0x1F;
+            ++memory.side_effects;
+            events.schedule(VblankEnd, time + frame_length);
+            break;
+        case Nmi:
+            processor.nmi();
+            break;
+        case FrameIrq:
+            if (audio.frame_irq_enabled())
+            {
+                audio.frame_irq = true;
+                memory.irq_sources |= memory.irq_frame_counter;
+                ++memory.side_effects;
+                events.schedule(FrameIrq, time + Region::frame_irq_period * scheduler::cpu_divider);
+            }
+            break;
+        case OamDma:
+            oam_dma();
+            break;
+        default:
+            break;
+        }
+    };
+
+    template <typename Region>
+    void basic_system<Region>::oam_dma()
+    {
+        auto& memory = processor.memory;
+        byte start = video.oam_address;
+        if (const byte* source = memory.read_pages[memory.dma_page])
+        {
+            std::copy(source, source + 0x100 - start, video.oam.begin() + start);
+            std::copy(source + 0x100 - start, source + 0x100, video.oam.begin());
+        }
+        else
+        {
+            // Copying from registers, for whatever
+            // reason - every read counts.
+            for (int offset = 0; offset < 0x100; ++offset)
+            {
+                video.oam[byte(start + offset)] = memory.read(word(memory.dma_page << 8) | offset);
+            }
+        }
+        uint64_t stall = 513 + (processor.cycles & 1);
+        processor.cycles += stall;
+        dma_stall_cycles += stall;
+        ++memory.side_effects;
+    };
+
+    template struct basic_system<ntsc>;
+    template struct basic_system<pal>;
+    template struct basic_system<dendy>;
+};
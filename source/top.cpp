@@ -0,0 +1,184 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <signal.h>
+
+#include "spdlog/spdlog.h"
+
+#include "shared_stats.hpp"
+
+// Shows every running emulator on this machine,
+// live, from the stats they publish (see
+// shared_stats.hpp). Usage:
+//
+//     emulatte-top [--interval ms] [--once]
+//
+// Rates are worked out between refreshes, so
+// --once only has the last frame's numbers to go
+// on. For each instance:
+//
+//     FPS     frames a second
+//     MIPS    millions of instructions a second
+//     MS      busy time of the last frame
+//     CPU/EVT how that time was split between
+//             the CPU and handling events
+//     IDLE    share of the last frame's cycles
+//             fast-forwarded in idle loops
+//     DMA     cycles the CPU spent stalled on
+//             OAM DMA in the last frame
+namespace
+{
+    namespace fs = std::filesystem;
+    using emulatte::perf_counters;
+    using emulatte::shared_stats;
+    using emulatte::shared_stats_reader;
+
+    struct instance
+    {
+        std::unique_ptr<shared_stats_reader> reader;
+        shared_stats_reader::sample previous;
+        std::chrono::steady_clock::time_point previous_time;
+        bool has_previous = false;
+    };
+
+    double percent(uint64_t part, uint64_t whole)
+    {
+        return whole ? 100.0 * double(part) / double(whole) : 0.0;
+    };
+
+    // POSIX shared memory objects show up as files
+    // here on Linux, which is the only way to list
+    // them.
+    std::vector<std::string> find_objects()
+    {
+        std::vector<std::string> names;
+        std::string_view prefix = shared_stats::name_prefix + 1;
+        std::error_code error;
+        for (const auto& entry : fs::directory_iterator("/dev/shm", error))
+        {
+            std::string name = entry.path().filename().string();
+            if (name.starts_with(prefix))
+            {
+                names.push_back("/" + name);
+            }
+        }
+        return names;
+    };
+
+    void refresh(std::map<std::string, instance>& instances, bool clear)
+    {
+        // Pick up new instances, and forget ones
+        // whose object has gone.
+        std::vector<std::string> names = find_objects();
+        std::map<std::string, instance> current;
+        for (const std::string& name : names)
+        {
+            auto found = instances.find(name);
+            if (found != instances.end())
+            {
+                current[name] = std::move(found->second);
+                continue;
+            }
+            auto reader = std::make_unique<shared_stats_reader>();
+            if (reader->open(name))
+            {
+                current[name].reader = std::move(reader);
+            }
+        }
+        instances = std::move(current);
+
+        std::string out = clear ? "\x1b[H\x1b[2J" : "";
+        out += fmt::format("{:>8} {:<6} {:>9} {:>8} {:>7} {:>5} {:>5} {:>5} {:>6}  {}\n",
+                           "PID", "REGION", "FPS", "MIPS", "MS", "CPU%", "EVT%", "IDLE%", "DMA", "ROM");
+        auto now = std::chrono::steady_clock::now();
+        for (auto& [name, watched] : instances)
+        {
+            shared_stats_reader::sample sample;
+            if (!watched.reader->read(sample))
+            {
+                continue;
+            }
+            // Killed without getting to clean up.
+            if (kill(sample.pid, 0) != 0 && errno == ESRCH)
+            {
+                continue;
+            }
+
+            const perf_counters& frame = sample.last_frame;
+            uint64_t busy = frame.cpu_nanoseconds + frame.event_nanoseconds;
+            double fps = 0;
+            double mips = 0;
+            if (watched.has_previous)
+            {
+                double seconds = std::chrono::duration<double>(now - watched.previous_time).count();
+                perf_counters ran = sample.totals - watched.previous.totals;
+                fps = ran.frames / seconds;
+                mips = ran.instructions / seconds / 1e6;
+            }
+            else if (busy)
+            {
+                // Nothing to compare with yet, so go by
+                // how fast the last frame was.
+                fps = 1e9 * frame.frames / busy;
+                mips = 1e3 * frame.instructions / busy;
+            }
+
+            out += fmt::format("{:>8} {:<6} {:>9.1f} {:>8.2f} {:>7.3f} {:>5.1f} {:>5.1f} {:>5.1f} {:>6}  {}\n",
+                               sample.pid, sample.region, fps, mips, busy / 1e6,
+                               percent(frame.cpu_nanoseconds, busy), percent(frame.event_nanoseconds, busy),
+                               percent(frame.idle_cycles_skipped, frame.cycles), frame.dma_stall_cycles,
+                               sample.rom);
+
+            watched.previous = sample;
+            watched.previous_time = now;
+            watched.has_previous = true;
+        }
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+    };
+};
+
+int main(int argc, char** argv)
+{
+    auto interval = std::chrono::milliseconds(1000);
+    bool once = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--interval" && i + 1 < argc)
+        {
+            interval = std::chrono::milliseconds(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        }
+        else if (arg == "--once")
+        {
+            once = true;
+        }
+        else
+        {
+            spdlog::error("usage: emulatte-top [--interval ms] [--once]");
+            return 1;
+        }
+    }
+
+    std::map<std::string, instance> instances;
+    while (true)
+    {
+        refresh(instances, !once);
+        if (once)
+        {
+            return 0;
+        }
+        std::this_thread::sleep_for(interval);
+    }
+};
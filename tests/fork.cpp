@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include "spdlog/spdlog.h"
+
+#include "state_hash.hpp"
+#include "system.hpp"
+#include "test_rom.hpp"
+
+// Forks are meant to be about as cheap as a
+// save(), by sharing memory page by page rather
+// than copying it, and to leave the system they
+// come from alone. This checks that a fork
+// shares what it should, and that nothing leaks
+// from one side to the other. What one costs
+// next to a save() is printed, but not checked:
+// timings are too noisy for a pass or a fail.
+namespace
+{
+    bool check(bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            spdlog::error("{}", what);
+        }
+        return condition;
+    };
+
+    // The best of a few batches, in nanoseconds
+    // per call, so a busy machine doesn't decide
+    // the result.
+    template <typename F>
+    double time_per_call(F&& call)
+    {
+        constexpr int batches = 5;
+        constexpr int calls = 1000;
+        double best = 1e18;
+        for (int batch = 0; batch < batches; ++batch)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < calls; ++i)
+            {
+                call();
+            }
+            std::chrono::duration<double, std::nano> took = std::chrono::steady_clock::now() - start;
+            best = std::min(best, took.count() / calls);
+        }
+        return best;
+    };
+};
+
+int main()
+{
+    auto path = emulatte::test::write_rom("fork");
+    auto nes = std::make_unique<emulatte::system>();
+    bool loaded = nes->load_rom(path);
+    std::filesystem::remove(path);
+    if (!loaded)
+    {
+        spdlog::error("couldn't load the test program");
+        return 1;
+    }
+    nes->reset();
+    for (int frame = 0; frame < 30; ++frame)
+    {
+        nes->run_frame();
+    }
+
+    bool ok = true;
+    auto& memory = nes->processor.memory;
+    uint64_t before = emulatte::hash_state(*nes);
+    auto write_pages = memory.write_pages;
+    auto child = nes->fork();
+
+    // Taking the fork left us as we were.
+    ok &= check(emulatte::hash_state(*nes) == before, "forking changed the source's state");
+    ok &= check(memory.write_pages == write_pages, "forking changed the source's page table");
+    ok &= check(emulatte::hash_state(*child) == before, "the fork isn't in the source's state");
+
+    // Everything big is shared.
+    ok &= check(child->cart == nes->cart, "the fork has its own copy of the ROM");
+    ok &= check(child->processor.memory.pages == memory.pages, "the fork has its own page table");
+    ok &= check(child->video.nametables == nes->video.nametables, "the fork has its own nametables");
+    ok &= check(child->video.patterns == nes->video.patterns, "the fork has its own CHR");
+
+    // Writes on either side stay on that side: the
+    // source writing PRG-RAM, and the fork writing
+    // a nametable through $2006/$2007.
+    emulatte::byte counted = child->processor.memory.read(0x6000);
+    memory.write(0x6000, emulatte::byte(counted + 0x5A));
+    ok &= check(child->processor.memory.read(0x6000) == counted, "the source's PRG-RAM write reached the fork");
+    auto& fork_memory = child->processor.memory;
+    fork_memory.read(0x2002);
+    fork_memory.write(0x2006, 0x20);
+    fork_memory.write(0x2006, 0x00);
+    fork_memory.write(0x2007, 0xA5);
+    ok &= check(nes->video.read_vram(0x2000) == 0x00, "the fork's nametable write reached the source");
+    ok &= check(child->video.read_vram(0x2000) == 0xA5, "the fork's nametable write went missing");
+
+    // And from the same state, the two run the same.
+    auto twin = nes->fork();
+    for (int frame = 0; frame < 30; ++frame)
+    {
+        nes->run_frame();
+        twin->run_frame();
+    }
+    ok &= check(emulatte::hash_state(*nes) == emulatte::hash_state(*twin), "a fork ran differently from its source");
+
+    // What it costs, next to a save(). A fork is
+    // a new system on the heap, and starts with
+    // a blank framebuffer, so it won't be quite
+    // as cheap - but it shouldn't be anywhere
+    // near copying all the memory. This is only
+    // for reading, since how long anything takes
+    // depends on the build and the machine.
+    auto state = std::make_unique<emulatte::system::snapshot>();
+    double save_ns = time_per_call([&] { nes->save(*state); });
+    double fork_ns = time_per_call([&] { child = nes->fork(); });
+    spdlog::info("save() {:.0f}ns, fork() {:.0f}ns ({:.1f}x)", save_ns, fork_ns, fork_ns / save_ns);
+
+    return ok ? 0 : 1;
+};
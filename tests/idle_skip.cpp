@@ -0,0 +1,59 @@
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+#include "spdlog/spdlog.h"
+
+#include "state_hash.hpp"
+#include "system.hpp"
+#include "test_rom.hpp"
+
+// Skipping idle loops is only allowed if nobody
+// can tell: the state after every frame has to
+// be exactly what emulating every pass of the
+// loop gives. This runs the test program (see
+// test_rom.hpp) both ways and checks the state
+// hashes of each frame against each other.
+
+int main()
+{
+    constexpr uint64_t frames = 600;
+
+    auto path = emulatte::test::write_rom("idle-skip");
+
+    auto skipping = std::make_unique<emulatte::system>();
+    auto stepping = std::make_unique<emulatte::system>();
+    bool loaded = skipping->load_rom(path) && stepping->load_rom(path);
+    std::filesystem::remove(path);
+    if (!loaded)
+    {
+        spdlog::error("couldn't load the test program");
+        return 1;
+    }
+    skipping->reset();
+    stepping->reset();
+    skipping->processor.skip_idle_loops = true;
+    stepping->processor.skip_idle_loops = false;
+
+    for (uint64_t frame = 0; frame < frames; ++frame)
+    {
+        skipping->run_frame();
+        stepping->run_frame();
+        if (emulatte::hash_state(*skipping) != emulatte::hash_state(*stepping))
+        {
+            spdlog::error("frame {}: skipping idle loops changed the state", skipping->frame);
+            return 1;
+        }
+    }
+
+    // If nothing was skipped, the test didn't
+    // test anything.
+    if (skipping->processor.idle_cycles_skipped == 0)
+    {
+        spdlog::error("no idle loop was skipped in {} frames", frames);
+        return 1;
+    }
+    spdlog::info("{} frames match, {} cycles skipped in idle loops",
+                 frames, skipping->processor.idle_cycles_skipped);
+    return 0;
+};
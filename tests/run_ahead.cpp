@@ -0,0 +1,159 @@
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <string>
+
+#include <unistd.h>
+
+#include "spdlog/spdlog.h"
+
+#include "debugger.hpp"
+#include "run_ahead.hpp"
+#include "state_hash.hpp"
+#include "system.hpp"
+#include "test_rom.hpp"
+
+// Run-ahead is meant to cost nothing but the
+// frames it runs: no allocations once it gets
+// going, with a save file or without, and no
+// trace left behind on the system it runs on -
+// its state, its save file, or a debugger's
+// watches on it.
+namespace
+{
+    // Only allocations made on the thread running
+    // the frames count. The save file's flusher
+    // has a thread of its own, which allocates as
+    // it starts up, whenever that happens to be.
+    thread_local bool counting = false;
+    uint64_t allocations = 0;
+
+    bool check(bool condition, const char* what)
+    {
+        if (!condition)
+        {
+            spdlog::error("{}", what);
+        }
+        return condition;
+    };
+
+    // Runs a system with run-ahead next to a
+    // twin without it, and checks the two end up
+    // the same. Gives back how many allocations
+    // the frames took once things had settled.
+    uint64_t run_alongside(emulatte::system& nes, emulatte::system& twin, bool& ok)
+    {
+        auto ahead = std::make_unique<emulatte::run_ahead>(nes, 2);
+        for (int frame = 0; frame < 10; ++frame)
+        {
+            ahead->run_frame(0, 0);
+            twin.run_frame();
+        }
+        allocations = 0;
+        counting = true;
+        for (int frame = 0; frame < 60; ++frame)
+        {
+            ahead->run_frame(0, 0);
+        }
+        counting = false;
+        uint64_t made = allocations;
+        for (int frame = 0; frame < 60; ++frame)
+        {
+            twin.run_frame();
+        }
+        ok &= check(emulatte::hash_state(nes) == emulatte::hash_state(twin), "running ahead changed the real frames");
+        return made;
+    };
+};
+
+void* operator new(std::size_t size)
+{
+    if (counting)
+    {
+        ++allocations;
+    }
+    if (void* block = std::malloc(size ? size : 1))
+    {
+        return block;
+    }
+    throw std::bad_alloc{};
+};
+
+void operator delete(void* block) noexcept
+{
+    std::free(block);
+};
+
+void operator delete(void* block, std::size_t) noexcept
+{
+    std::free(block);
+};
+
+int main()
+{
+    auto path = emulatte::test::write_rom("run-ahead");
+    auto save_path = std::filesystem::temp_directory_path() /
+                     ("emulatte-run-ahead-" + std::to_string(getpid()) + ".sav");
+    auto nes = std::make_unique<emulatte::system>();
+    auto twin = std::make_unique<emulatte::system>();
+    auto saved = std::make_unique<emulatte::system>();
+    auto saved_twin = std::make_unique<emulatte::system>();
+    bool loaded = nes->load_rom(path) && twin->load_rom(path) &&
+                  saved->load_rom(path) && saved_twin->load_rom(path) &&
+                  saved->load_battery(save_path);
+    std::filesystem::remove(path);
+    if (!loaded)
+    {
+        std::filesystem::remove(save_path);
+        spdlog::error("couldn't load the test program");
+        return 1;
+    }
+    for (auto* system : { nes.get(), twin.get(), saved.get(), saved_twin.get() })
+    {
+        system->reset();
+    }
+
+    bool ok = true;
+    ok &= check(run_alongside(*nes, *twin, ok) == 0, "running ahead allocated without a save file");
+    ok &= check(run_alongside(*saved, *saved_twin, ok) == 0, "running ahead allocated with a save file");
+    // The program counts frames at $6000, and
+    // the file should have the real count, not
+    // one from frames that were run ahead.
+    ok &= check(saved->battery->data()[0] == saved_twin->processor.memory.read(0x6000), "frames run ahead reached the save file");
+
+    // Watches set before running ahead still go
+    // off afterwards, RAM and PRG-RAM both, and
+    // writes they catch still land in the file.
+    {
+        emulatte::debugger debugger{ *saved };
+        debugger.add_watchpoint(0x0010, 0x0010, false, true);
+        debugger.add_watchpoint(0x6000, 0x6000, false, true);
+        emulatte::run_ahead ahead{ *saved, 2 };
+        ahead.run_frame(0, 0);
+
+        bool ram_seen = false;
+        bool prg_ram_seen = false;
+        for (int stop = 0; stop < 20 && !(ram_seen && prg_ram_seen); ++stop)
+        {
+            auto last = debugger.run_frame();
+            if (last.reason != emulatte::debugger::stop_reason::Watchpoint)
+            {
+                continue;
+            }
+            ram_seen |= last.address == 0x0010;
+            if (last.address == 0x6000)
+            {
+                prg_ram_seen = true;
+                ok &= check(saved->battery->data()[0] == last.value, "a watched PRG-RAM write missed the save file");
+            }
+        }
+        ok &= check(ram_seen, "a RAM watch stopped firing after running ahead");
+        ok &= check(prg_ram_seen, "a PRG-RAM watch stopped firing after running ahead");
+    }
+
+    saved.reset();
+    std::filesystem::remove(save_path);
+    return ok ? 0 : 1;
+};
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "fundamentals.hpp"
+
+namespace emulatte::test
+{
+    // A small NROM program for the tests to run,
+    // built here rather than checked in. It waits
+    // for vblank the way most games do, by
+    // spinning on a flag its NMI handler sets,
+    // then does a different amount of busy work
+    // each frame so the wait is entered at every
+    // point of the frame sooner or later. The NMI
+    // handler counts frames in PRG-RAM, and starts
+    // an OAM DMA too, so a DMA stall lands in the
+    // middle of it.
+    inline std::vector<byte> build_rom()
+    {
+        std::vector<byte> rom(16 + 0x4000 + 0x2000, 0);
+        const byte header[] = { 'N', 'E', 'S', 0x1A, 1, 1 };
+        std::copy(std::begin(header), std::end(header), rom.begin());
+
+        const byte program[] = {
+            0x78,             // $8000 reset: SEI
+            0xD8,             // $8001        CLD
+            0xA2, 0xFF,       // $8002        LDX #$FF
+            0x9A,             // $8004        TXS
+            0xA9, 0x80,       // $8005        LDA #$80
+            0x8D, 0x00, 0x20, // $8007        STA $2000  ; NMI on
+            0xA5, 0x10,       // $800A wait:  LDA $10
+            0xF0, 0xFC,       // $800C        BEQ wait   ; the idle loop
+            0xA9, 0x00,       // $800E        LDA #0
+            0x85, 0x10,       // $8010        STA $10
+            0xE6, 0x11,       // $8012        INC $11
+            0xA6, 0x11,       // $8014        LDX $11
+            0xCA,             // $8016 busy:  DEX
+            0xD0, 0xFD,       // $8017        BNE busy
+            0x4C, 0x0A, 0x80, // $8019        JMP wait
+            0xE6, 0x10,       // $801C nmi:   INC $10
+            0xE6, 0x12,       // $801E        INC $12
+            0xEE, 0x00, 0x60, // $8020        INC $6000
+            0xA9, 0x02,       // $8023        LDA #2
+            0x8D, 0x14, 0x40, // $8025        STA $4014
+            0x40,             // $8028        RTI
+            0x40,             // $8029 irq:   RTI
+        };
+        std::copy(std::begin(program), std::end(program), rom.begin() + 16);
+
+        // NMI, reset and IRQ vectors.
+        const byte vectors[] = { 0x1C, 0x80, 0x00, 0x80, 0x29, 0x80 };
+        std::copy(std::begin(vectors), std::end(vectors), rom.begin() + 16 + 0x3FFA);
+        return rom;
+    };
+
+    // Writes the program to a file of its own
+    // for load_rom, and gives back where. It's up
+    // to the caller to remove it.
+    inline std::filesystem::path write_rom(const std::string& name)
+    {
+        auto path = std::filesystem::temp_directory_path() /
+                    ("emulatte-" + name + "-" + std::to_string(getpid()) + ".nes");
+        auto rom = build_rom();
+        std::ofstream out(path, std::ios::binary);
+        out.write(reinterpret_cast<const char*>(rom.data()), rom.size());
+        return path;
+    };
+};